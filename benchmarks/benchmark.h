@@ -0,0 +1,13 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <time.h>
+
+// Returns the current time of a monotonic clock in seconds.
+static inline double benchmark_now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec/1e9;
+}
+
+#endif // BENCHMARK_H
@@ -0,0 +1,148 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "benchmark.h"
+#include "concurrent_map.h"
+#include "map.h"
+
+static const size_t keys_count = 200000;
+
+// Each thread looks up this many keys for every key it adds, about what resolving names in a large
+// program does.
+static const size_t lookups_per_add = 8;
+
+// Threads beyond the machine's core count only share the cores, so past that point the numbers show
+// locking overhead rather than scaling.
+static const size_t max_threads_count = 32;
+
+// Identifiers like "module_12.symbol_345", back to back.
+struct keys {
+	char *bytes;
+	size_t *starts; // One more than the number of keys; the last is the end of the bytes.
+};
+
+// The baseline: one "map.h" map behind one lock.
+struct locked_map {
+	size_t *map;
+	pthread_mutex_t mutex;
+};
+
+struct worker {
+	struct keys *keys;
+	struct concurrent_map *concurrent_map; // Null when timing `locked_map`.
+	struct locked_map *locked_map;
+	size_t first;
+	size_t count;
+	size_t found_count;
+};
+
+static bool make_keys(struct keys *keys) {
+	*keys = (struct keys){
+		.bytes = malloc(keys_count*32),
+		.starts = malloc((keys_count + 1)*sizeof *keys->starts),
+	};
+	if (!keys->bytes || !keys->starts) {
+		free(keys->bytes);
+		free(keys->starts);
+		return false;
+	}
+	size_t size = 0;
+	for (size_t i = 0; i < keys_count; ++i) {
+		keys->starts[i] = size;
+		size += sprintf(keys->bytes + size, "module_%zu.symbol_%zu", i%97, i);
+	}
+	keys->starts[keys_count] = size;
+	return true;
+}
+
+// Adds the worker's keys, looking up keys other threads are adding at the same time in between.
+static void *run_worker(void *argument) {
+	struct worker *worker = argument;
+	struct keys *keys = worker->keys;
+	size_t found_count = 0;
+	size_t lookup = worker->first*7919;
+	for (size_t i = worker->first; i < worker->first + worker->count; ++i) {
+		const char *key = keys->bytes + keys->starts[i];
+		size_t length = keys->starts[i + 1] - keys->starts[i];
+		if (worker->concurrent_map) {
+			concurrent_map_add(worker->concurrent_map, key, length, &i);
+		} else {
+			pthread_mutex_lock(&worker->locked_map->mutex);
+			map_add_n(&worker->locked_map->map, key, length, &i);
+			pthread_mutex_unlock(&worker->locked_map->mutex);
+		}
+		for (size_t j = 0; j < lookups_per_add; ++j) {
+			lookup = (lookup + 7919)%keys_count;
+			key = keys->bytes + keys->starts[lookup];
+			length = keys->starts[lookup + 1] - keys->starts[lookup];
+			if (worker->concurrent_map) {
+				found_count += concurrent_map_get(worker->concurrent_map, key, length) != NULL;
+			} else {
+				pthread_mutex_lock(&worker->locked_map->mutex);
+				found_count += map_get_n(&worker->locked_map->map, key, length) != NULL;
+				pthread_mutex_unlock(&worker->locked_map->mutex);
+			}
+		}
+	}
+	worker->found_count = found_count;
+	return NULL;
+}
+
+// Splits the keys between `threads_count` threads and returns how long they took to add and look them
+// all up.
+static double run_workers(struct keys *keys, size_t threads_count, struct concurrent_map *concurrent_map, struct locked_map *locked_map) {
+	pthread_t threads[max_threads_count];
+	struct worker workers[max_threads_count];
+	double start = benchmark_now();
+	for (size_t i = 0; i < threads_count; ++i) {
+		size_t first = keys_count*i/threads_count;
+		workers[i] = (struct worker){
+			.keys = keys,
+			.concurrent_map = concurrent_map,
+			.locked_map = locked_map,
+			.first = first,
+			.count = keys_count*(i + 1)/threads_count - first,
+		};
+		if (pthread_create(threads + i, NULL, run_worker, workers + i) != 0) {
+			fprintf(stderr, "Couldn't create a thread.\n");
+			exit(1);
+		}
+	}
+	for (size_t i = 0; i < threads_count; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	return benchmark_now() - start;
+}
+
+int main(void) {
+	struct keys keys;
+	if (!make_keys(&keys)) {
+		fprintf(stderr, "Memory error.\n");
+		return 1;
+	}
+	size_t operations_count = keys_count*(1 + lookups_per_add);
+	printf("%7s %28s %28s\n", "threads", "map.h behind one mutex", "concurrent_map");
+	for (size_t threads_count = 1; threads_count <= max_threads_count; threads_count *= 2) {
+		struct locked_map locked_map = {
+			.map = map_create(0, sizeof(size_t), 1024),
+			.mutex = PTHREAD_MUTEX_INITIALIZER,
+		};
+		struct concurrent_map concurrent_map = concurrent_map_create(4*threads_count, sizeof(size_t));
+		if (!locked_map.map || !concurrent_map.shards) {
+			fprintf(stderr, "Memory error.\n");
+			return 1;
+		}
+		double locked_seconds = run_workers(&keys, threads_count, NULL, &locked_map);
+		double concurrent_seconds = run_workers(&keys, threads_count, &concurrent_map, NULL);
+		printf("%7zu %20.1f Mops/s %20.1f Mops/s\n", threads_count, operations_count/locked_seconds/1e6, operations_count/concurrent_seconds/1e6);
+		map_destroy(&locked_map.map);
+		concurrent_map_destroy(&concurrent_map);
+	}
+	free(keys.bytes);
+	free(keys.starts);
+	return 0;
+}
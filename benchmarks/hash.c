@@ -0,0 +1,267 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmark.h"
+#include "hash.h"
+#include "map.h"
+
+static const size_t keys_count = 50000;
+
+static const size_t repetitions = 20;
+
+// Lookups that visit this many groups or more share the last column of the histogram.
+#define PROBE_LENGTHS_COUNT 4
+
+// Keys of one distribution, back to back, with where each one starts.
+struct keys {
+	const char *name;
+	char *bytes;
+	size_t *starts; // One more than the number of keys; the last is the end of the bytes.
+	size_t size;
+};
+
+struct hash_function {
+	const char *name;
+	uint64_t (*hash)(const char *key, size_t length);
+};
+
+// `hash_string()` is inline, so calling it through a pointer needs a wrapper.
+static uint64_t hash_string_function(const char *key, size_t length) {
+	return hash_string(key, length);
+}
+
+static const struct hash_function hash_functions[] = {
+	{"fnv-1a (before)", hash_fnv1a},
+	{"hash_string (after)", hash_string_function},
+};
+
+// Makes the `index`th key of a distribution.
+typedef size_t (*make_key_function)(char *key, size_t index);
+
+// Random identifiers between 1 and 12 characters long.
+static size_t make_random_key(char *key, size_t index) {
+	(void)index;
+	size_t length = 1 + rand()%12;
+	key[0] = 'a' + rand()%26;
+	for (size_t i = 1; i < length; ++i) {
+		key[i] = "abcdefghijklmnopqrstuvwxyz_0123456789"[rand()%37];
+	}
+	return length;
+}
+
+// Snake case names made of common words, like the identifiers in real code.
+static size_t make_word_key(char *key, size_t index) {
+	static const char *const words[] = {
+		"current", "next", "previous", "token", "node", "index", "count", "length", "name", "type",
+		"value", "parser", "lexer", "symbol", "table", "is", "get", "set", "child", "parent",
+		"text", "start", "end", "buffer", "error", "scope", "object", "line", "first", "last",
+	};
+	size_t words_count = sizeof words/sizeof *words;
+	// Spell `index` in base `words_count`, so every key is different.
+	size_t length = 0;
+	do {
+		if (length) {
+			key[length++] = '_';
+		}
+		const char *word = words[index%words_count];
+		memcpy(key + length, word, strlen(word));
+		length += strlen(word);
+		index /= words_count;
+	} while (index);
+	return length;
+}
+
+// Names that only differ in a counter at the end, like generated temporaries. Weak hashes cluster on
+// these.
+static size_t make_numbered_key(char *key, size_t index) {
+	return sprintf(key, "temporary%zu", index);
+}
+
+// Long qualified names, 20 to 60 characters.
+static size_t make_qualified_key(char *key, size_t index) {
+	return sprintf(key, "compiler.front_end.module_%zu.definitions.symbol_%zu", index%97, index);
+}
+
+static void destroy_keys(struct keys *keys) {
+	free(keys->bytes);
+	free(keys->starts);
+}
+
+static bool make_keys(struct keys *keys, const char *name, make_key_function make_key) {
+	*keys = (struct keys){
+		.name = name,
+		.bytes = malloc(keys_count*64),
+		.starts = malloc((keys_count + 1)*sizeof *keys->starts),
+	};
+	if (!keys->bytes || !keys->starts) {
+		destroy_keys(keys);
+		return false;
+	}
+	// Duplicates would make every hash look like it collides, so only keep the first of each key.
+	size_t *seen = map_create(keys_count, 0, keys_count*16);
+	if (!seen) {
+		destroy_keys(keys);
+		return false;
+	}
+	srand(1);
+	for (size_t i = 0, j = 0; i < keys_count; ++j) {
+		size_t length = make_key(keys->bytes + keys->size, j);
+		if (map_get_n(&seen, keys->bytes + keys->size, length)) {
+			continue;
+		}
+		if (!map_add_n(&seen, keys->bytes + keys->size, length, &j)) {
+			map_destroy(&seen);
+			destroy_keys(keys);
+			return false;
+		}
+		keys->starts[i++] = keys->size;
+		keys->size += length;
+	}
+	keys->starts[keys_count] = keys->size;
+	map_destroy(&seen);
+	return true;
+}
+
+// Adds every key to a table laid out like the ones in "map.c", then looks every key up again the way
+// `map_get()` would, counting the groups each lookup visits and the tags that match a different key.
+static void count_probe_lengths(struct keys *keys, const struct hash_function *function, size_t histogram[PROBE_LENGTHS_COUNT], size_t *false_matches) {
+	size_t capacity = 16;
+	while (capacity - capacity/8 < keys_count) {
+		capacity *= 2;
+	}
+	size_t groups_mask = capacity/16 - 1;
+	uint8_t *tags = malloc(capacity);
+	size_t *owners = malloc(capacity*sizeof *owners);
+	uint64_t *hashes = malloc(keys_count*sizeof *hashes);
+	if (!tags || !owners || !hashes) {
+		fprintf(stderr, "Memory error.\n");
+		exit(1);
+	}
+	memset(tags, 0x80, capacity);
+	for (size_t i = 0; i < keys_count; ++i) {
+		hashes[i] = function->hash(keys->bytes + keys->starts[i], keys->starts[i + 1] - keys->starts[i]);
+		size_t group = (hashes[i] >> 7) & groups_mask;
+		for (size_t step = 1;; ++step) {
+			size_t free_index = SIZE_MAX;
+			for (size_t j = 0; j < 16 && free_index == SIZE_MAX; ++j) {
+				if (tags[group*16 + j] == 0x80) {
+					free_index = group*16 + j;
+				}
+			}
+			if (free_index != SIZE_MAX) {
+				tags[free_index] = hashes[i] & 0x7F;
+				owners[free_index] = i;
+				break;
+			}
+			group = (group + step) & groups_mask;
+		}
+	}
+	for (size_t i = 0; i < keys_count; ++i) {
+		size_t group = (hashes[i] >> 7) & groups_mask;
+		for (size_t step = 1;; ++step) {
+			bool found = false;
+			for (size_t j = 0; j < 16; ++j) {
+				if (tags[group*16 + j] == (hashes[i] & 0x7F)) {
+					if (owners[group*16 + j] == i) {
+						found = true;
+					} else {
+						++*false_matches;
+					}
+				}
+			}
+			if (found) {
+				++histogram[step <= PROBE_LENGTHS_COUNT ? step - 1 : PROBE_LENGTHS_COUNT - 1];
+				break;
+			}
+			group = (group + step) & groups_mask;
+		}
+	}
+	free(tags);
+	free(owners);
+	free(hashes);
+}
+
+static void benchmark_hash(struct keys *keys, const struct hash_function *function) {
+	uint64_t checksum = 0;
+	double start = benchmark_now();
+	for (size_t i = 0; i < repetitions; ++i) {
+		for (size_t j = 0; j < keys_count; ++j) {
+			checksum += function->hash(keys->bytes + keys->starts[j], keys->starts[j + 1] - keys->starts[j]);
+		}
+	}
+	double seconds = benchmark_now() - start;
+
+	size_t histogram[PROBE_LENGTHS_COUNT] = {0};
+	size_t false_matches = 0;
+	count_probe_lengths(keys, function, histogram, &false_matches);
+	printf("%-10s %-20s %8.1f MB/s %8.1f Mkeys/s |", keys->name, function->name, keys->size*repetitions/seconds/1e6, keys_count*repetitions/seconds/1e6);
+	for (size_t i = 0; i < PROBE_LENGTHS_COUNT; ++i) {
+		printf(" %6.2f%%", 100.0*histogram[i]/keys_count);
+	}
+	// Printing part of the checksum keeps the hashing from being optimized away.
+	printf(" | %6.3f (%02" PRIx64 ")\n", (double)false_matches/keys_count, checksum & 0xFF);
+}
+
+// Times the map itself, which always uses `hash_string()`.
+static void benchmark_map(struct keys *keys) {
+	char key[64];
+	size_t *map = map_create(0, sizeof *map, 1024);
+	if (!map) {
+		fprintf(stderr, "Memory error.\n");
+		exit(1);
+	}
+	double start = benchmark_now();
+	for (size_t i = 0; i < keys_count; ++i) {
+		map_add_n(&map, keys->bytes + keys->starts[i], keys->starts[i + 1] - keys->starts[i], &i);
+	}
+	double add_seconds = benchmark_now() - start;
+	size_t found_count = 0;
+	start = benchmark_now();
+	for (size_t i = 0; i < repetitions; ++i) {
+		for (size_t j = 0; j < keys_count; ++j) {
+			found_count += map_get_n(&map, keys->bytes + keys->starts[j], keys->starts[j + 1] - keys->starts[j]) != NULL;
+		}
+	}
+	double get_seconds = benchmark_now() - start;
+	// Misses stop at the first group with an empty bucket.
+	start = benchmark_now();
+	for (size_t i = 0; i < keys_count; ++i) {
+		size_t length = sprintf(key, "missing_%zu", i);
+		found_count += map_get_n(&map, key, length) != NULL;
+	}
+	double miss_seconds = benchmark_now() - start;
+	printf("%-10s map_add_n %7.1f ns/key, map_get_n %7.1f ns/key, misses %7.1f ns/key (%zu found)\n", keys->name, add_seconds/keys_count*1e9, get_seconds/(keys_count*repetitions)*1e9, miss_seconds/keys_count*1e9, found_count/repetitions);
+	map_destroy(&map);
+}
+
+int main(void) {
+	struct {
+		const char *name;
+		make_key_function make_key;
+	} distributions[] = {
+		{"random", make_random_key},
+		{"words", make_word_key},
+		{"numbered", make_numbered_key},
+		{"qualified", make_qualified_key},
+	};
+	printf("%-10s %-20s %13s %16s | groups visited per lookup: 1, 2, 3, %d+ | false tag matches per lookup\n", "keys", "hash", "throughput", "", PROBE_LENGTHS_COUNT);
+	for (size_t i = 0; i < sizeof distributions/sizeof *distributions; ++i) {
+		struct keys keys;
+		if (!make_keys(&keys, distributions[i].name, distributions[i].make_key)) {
+			fprintf(stderr, "Memory error.\n");
+			return 1;
+		}
+		for (size_t j = 0; j < sizeof hash_functions/sizeof *hash_functions; ++j) {
+			benchmark_hash(&keys, hash_functions + j);
+		}
+		benchmark_map(&keys);
+		destroy_keys(&keys);
+	}
+	return 0;
+}
+
+#undef PROBE_LENGTHS_COUNT
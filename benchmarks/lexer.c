@@ -0,0 +1,194 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmark.h"
+#include "lexer.h"
+#include "token_columns.h"
+#include "list.h"
+
+#define max(a, b) (((a) >= (b)) ? (a) : (b))
+
+static const size_t words_count = 1000000;
+
+static const size_t repetitions = 10;
+
+static const size_t lines_count = 200000;
+
+static const size_t edited_lines_count = 100000;
+
+static const size_t edits_count = 10000;
+
+// The keyword search `lex()` used before the keyword table, kept here as a baseline.
+static enum token_type lookup_keyword_linear(const char *text, size_t length) {
+	for (size_t i = TOKEN_TYPE_NAMESPACE; i < TOKEN_TYPE_DOT; ++i) {
+		if (strncmp(token_type_names[i], text, max(strlen(token_type_names[i]), length)) == 0) {
+			return i;
+		}
+	}
+	return TOKEN_TYPE_IDENTIFIER;
+}
+
+// Makes a line of space separated words where roughly one in four is a keyword. The rest are
+// identifiers between 1 and 12 characters long.
+static char *make_text(size_t count) {
+	char *text = malloc(count*13 + 1);
+	if (!text) {
+		return NULL;
+	}
+	char *end = text;
+	srand(1);
+	for (size_t i = 0; i < count; ++i) {
+		if (rand()%4 == 0) {
+			const char *keyword = token_type_names[TOKEN_TYPE_NAMESPACE + rand()%(TOKEN_TYPE_DOT - TOKEN_TYPE_NAMESPACE)];
+			size_t length = strlen(keyword);
+			memcpy(end, keyword, length);
+			end += length;
+		} else {
+			size_t length = 1 + rand()%12;
+			*end++ = 'a' + rand()%26;
+			for (size_t j = 1; j < length; ++j) {
+				*end++ = "abcdefghijklmnopqrstuvwxyz_0123456789"[rand()%37];
+			}
+		}
+		*end++ = ' ';
+	}
+	*end = '\0';
+	return text;
+}
+
+// Makes indented lines of code with trailing comments, which is what most real source looks like.
+static char *make_source_text(size_t count) {
+	static const char *const lines[] = {
+		"\t\tvar current_token_index = previous_token_index + 1 // Skip the separator.\n",
+		"\t\t\tif is_whitespace_character(next_character) and not in_string_literal\n",
+		"\t// Returns the number of characters that were consumed by the last call.\n",
+		"\t\treturn parser.current_node_index\n",
+		"\n",
+	};
+	size_t lines_variants = sizeof lines/sizeof *lines;
+	size_t size = 1;
+	for (size_t i = 0; i < count; ++i) {
+		size += strlen(lines[i%lines_variants]);
+	}
+	char *text = malloc(size);
+	if (!text) {
+		return NULL;
+	}
+	char *end = text;
+	for (size_t i = 0; i < count; ++i) {
+		size_t length = strlen(lines[i%lines_variants]);
+		memcpy(end, lines[i%lines_variants], length);
+		end += length;
+	}
+	*end = '\0';
+	return text;
+}
+
+static void benchmark_lookup(char *text, const char *name, enum token_type (*lookup)(const char*, size_t)) {
+	size_t keywords_count = 0;
+	double start = benchmark_now();
+	for (size_t i = 0; i < repetitions; ++i) {
+		char *word = text;
+		while (*word) {
+			char *end = strchr(word, ' ');
+			keywords_count += lookup(word, end - word) != TOKEN_TYPE_IDENTIFIER;
+			word = end + 1;
+		}
+	}
+	double seconds = benchmark_now() - start;
+	printf("%-24s %12.0f words/s (%zu keywords)\n", name, words_count*repetitions/seconds, keywords_count/repetitions);
+}
+
+int main(void) {
+	char *text = make_text(words_count);
+	if (!text) {
+		fprintf(stderr, "Memory error.\n");
+		return 1;
+	}
+	benchmark_lookup(text, "linear search (before)", lookup_keyword_linear);
+	benchmark_lookup(text, "keyword table (after)", lookup_keyword);
+
+	double start = benchmark_now();
+	for (size_t i = 0; i < repetitions; ++i) {
+		struct token_columns tokens = {0};
+		struct lexer_error *errors = NULL;
+		lex(text, &tokens, &errors);
+		token_columns_destroy(&tokens);
+		list_destroy(&errors);
+	}
+	double seconds = benchmark_now() - start;
+	printf("%-24s %12.0f words/s\n", "lex()", words_count*repetitions/seconds);
+	free(text);
+
+	text = make_source_text(lines_count);
+	if (!text) {
+		fprintf(stderr, "Memory error.\n");
+		return 1;
+	}
+	size_t text_length = strlen(text);
+	start = benchmark_now();
+	for (size_t i = 0; i < repetitions; ++i) {
+		struct token_columns tokens = {0};
+		struct lexer_error *errors = NULL;
+		lex(text, &tokens, &errors);
+		token_columns_destroy(&tokens);
+		list_destroy(&errors);
+	}
+	seconds = benchmark_now() - start;
+	printf("%-24s %12.1f MB/s\n", "lex()", text_length*repetitions/seconds/1e6);
+
+	for (size_t threads_count = 1; threads_count <= 32; threads_count *= 2) {
+		start = benchmark_now();
+		for (size_t i = 0; i < repetitions; ++i) {
+			struct token_columns tokens = {0};
+			struct lexer_error *errors = NULL;
+			lex_parallel(text, text_length, threads_count, &tokens, &errors);
+			token_columns_destroy(&tokens);
+			list_destroy(&errors);
+		}
+		seconds = benchmark_now() - start;
+		printf("lex_parallel() %2zu threads %10.1f MB/s\n", threads_count, text_length*repetitions/seconds/1e6);
+	}
+	free(text);
+
+	// Type and delete a character at random places in a 100k line file.
+	text = make_source_text(edited_lines_count);
+	text_length = text ? strlen(text) : 0;
+	text = text ? realloc(text, text_length + 2) : NULL;
+	if (!text) {
+		fprintf(stderr, "Memory error.\n");
+		return 1;
+	}
+	struct token_columns tokens = {0};
+	struct lexer_error *errors = NULL;
+	start = benchmark_now();
+	lex_n(text, text_length, &tokens, &errors);
+	seconds = benchmark_now() - start;
+	printf("%-24s %12.1f us\n", "lex_n() 100k lines", seconds*1e6);
+	srand(4);
+	start = benchmark_now();
+	for (size_t i = 0; i < edits_count; ++i) {
+		struct text_edit edit = {
+			.text_index = rand()%text_length,
+			.inserted_length = 1,
+		};
+		memmove(text + edit.text_index + 1, text + edit.text_index, text_length - edit.text_index + 1);
+		text[edit.text_index] = 'x';
+		lex_edit(text, text_length + 1, &edit, &tokens, &errors);
+		edit = (struct text_edit){
+			.text_index = edit.text_index,
+			.removed_length = 1,
+		};
+		memmove(text + edit.text_index, text + edit.text_index + 1, text_length - edit.text_index + 1);
+		lex_edit(text, text_length, &edit, &tokens, &errors);
+	}
+	seconds = benchmark_now() - start;
+	printf("%-24s %12.1f us\n", "lex_edit() keystroke", seconds/(2*edits_count)*1e6);
+	token_columns_destroy(&tokens);
+	list_destroy(&errors);
+	free(text);
+	return 0;
+}
+
+#undef max
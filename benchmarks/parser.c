@@ -0,0 +1,103 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmark.h"
+#include "lexer.h"
+#include "token_columns.h"
+#include "parser.h"
+#include "list.h"
+#include "segmented_list.h"
+
+static const size_t lines_count = 500000;
+
+static const size_t repetitions = 10;
+
+// Makes a file of namespace definitions, the only statements the parser knows so far.
+static char *make_text(void) {
+	char *text = malloc(lines_count*48 + 1);
+	if (!text) {
+		return NULL;
+	}
+	char *end = text;
+	for (size_t i = 0; i < lines_count; ++i) {
+		end += sprintf(end, i%2 ? "pub namespace module_%zu.part.*\n" : "namespace module_%zu.part.name\n", i);
+	}
+	return text;
+}
+
+// Counts the tokens under `node_index` by following the links.
+static size_t count_node_tokens(struct segmented_list *nodes, size_t node_index) {
+	struct node *node = segmented_list_get(nodes, node_index);
+	if (node->type == NODE_TYPE_TOKEN) {
+		return 1;
+	}
+	size_t count = 0;
+	for (size_t child_index = node->child_index; child_index != NODE_NONE; child_index = ((struct node*)segmented_list_get(nodes, child_index))->next_index) {
+		count += count_node_tokens(nodes, child_index);
+	}
+	return count;
+}
+
+static size_t count_tree_tokens(struct syntax_tree *tree, uint32_t node_index) {
+	size_t count = 0;
+	uint32_t *children = tree->children + tree->children_starts[node_index];
+	for (uint32_t i = 0; i < tree->children_counts[node_index]; ++i) {
+		count += syntax_tree_is_token(children[i]) ? 1 : count_tree_tokens(tree, children[i]);
+	}
+	return count;
+}
+
+int main(void) {
+	char *text = make_text();
+	if (!text) {
+		fprintf(stderr, "Memory error.\n");
+		return 1;
+	}
+	struct token_columns tokens = {0};
+	struct lexer_error *lexer_errors = NULL;
+	lex(text, &tokens, &lexer_errors);
+
+	double parse_seconds = 0;
+	double walk_seconds = 0;
+	size_t bytes = 0;
+	size_t tokens_count = 0;
+	for (size_t i = 0; i < repetitions; ++i) {
+		struct segmented_list nodes = {0};
+		struct parser_error *errors = NULL;
+		double start = benchmark_now();
+		parse(&tokens, &nodes, &errors);
+		parse_seconds += benchmark_now() - start;
+		start = benchmark_now();
+		tokens_count = count_node_tokens(&nodes, 0);
+		walk_seconds += benchmark_now() - start;
+		bytes = nodes.count*sizeof(struct node);
+		segmented_list_destroy(&nodes);
+		list_destroy(&errors);
+	}
+	printf("%-16s %8.1f ms parse %8.1f ms walk %7.2f MB (%zu tokens)\n", "struct node", parse_seconds/repetitions*1e3, walk_seconds/repetitions*1e3, bytes/1e6, tokens_count);
+
+	parse_seconds = 0;
+	walk_seconds = 0;
+	for (size_t i = 0; i < repetitions; ++i) {
+		struct syntax_tree tree = {0};
+		struct parser_error *errors = NULL;
+		double start = benchmark_now();
+		parse_compact(&tokens, &tree, &errors);
+		parse_seconds += benchmark_now() - start;
+		start = benchmark_now();
+		tokens_count = count_tree_tokens(&tree, 0);
+		walk_seconds += benchmark_now() - start;
+		size_t nodes_count = list_get_count(&tree.types);
+		bytes = nodes_count*(sizeof *tree.types + sizeof *tree.parents + sizeof *tree.children_starts + sizeof *tree.children_counts) + list_get_count(&tree.children)*sizeof *tree.children;
+		syntax_tree_destroy(&tree);
+		list_destroy(&errors);
+	}
+	printf("%-16s %8.1f ms parse %8.1f ms walk %7.2f MB (%zu tokens)\n", "syntax_tree", parse_seconds/repetitions*1e3, walk_seconds/repetitions*1e3, bytes/1e6, tokens_count);
+
+	token_columns_destroy(&tokens);
+	list_destroy(&lexer_errors);
+	free(text);
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "benchmark.h"
+#include "visitor.h"
+#include "map.h"
+#include "interner.h"
+
+static const size_t repetitions = 20;
+
+// Times looking every symbol up in a symbol table's handle map, keyed by atom like
+// `initialize_symbols()` does, and in the frozen copy of it, keyed by name.
+static void benchmark_symbols(uint32_t count) {
+	struct symbol_table table = symbol_table_create(NULL, 16, 1024);
+	uint32_t *atoms = malloc(count*sizeof *atoms);
+	struct interned_name *names = malloc(count*sizeof *names);
+	struct interner *interner = interner_get_global();
+	if (!table.handles || !atoms || !names || !interner) {
+		fprintf(stderr, "Memory error.\n");
+		exit(1);
+	}
+	char name[32];
+	for (uint32_t i = 0; i < count; ++i) {
+		struct symbol_handle handle = {.index = i};
+		if (!interner_intern(interner, name, sprintf(name, "symbol_%" PRIu32, i), atoms + i) || !map_add_n(&table.handles, (const char*)(atoms + i), sizeof *atoms, &handle)) {
+			fprintf(stderr, "Memory error.\n");
+			exit(1);
+		}
+		names[i] = interner_get_name(interner, atoms[i]);
+	}
+	double start = benchmark_now();
+	struct frozen_symbol_table frozen = symbol_table_freeze(NULL, &table);
+	double freeze_seconds = benchmark_now() - start;
+	if (!frozen.block) {
+		fprintf(stderr, "Memory error.\n");
+		exit(1);
+	}
+	size_t checksum = 0;
+	start = benchmark_now();
+	for (size_t i = 0; i < repetitions; ++i) {
+		for (uint32_t j = 0; j < count; ++j) {
+			checksum += ((struct symbol_handle*)map_get_n(&table.handles, (const char*)(atoms + j), sizeof *atoms))->index;
+		}
+	}
+	double map_seconds = benchmark_now() - start;
+	start = benchmark_now();
+	for (size_t i = 0; i < repetitions; ++i) {
+		for (uint32_t j = 0; j < count; ++j) {
+			checksum -= frozen_symbol_table_get(&frozen, names[j].bytes, names[j].length)->index;
+		}
+	}
+	double frozen_seconds = benchmark_now() - start;
+	printf("%8" PRIu32 " symbols: map %6.1f ns/lookup, frozen %6.1f ns/lookup, %7.2f bytes/symbol frozen, freeze %8.2f ms, seed %" PRIu64 " (%zu)\n", count, map_seconds/(count*repetitions)*1e9, frozen_seconds/(count*repetitions)*1e9, (double)frozen.block_size/count, freeze_seconds*1e3, frozen.header->seed, checksum);
+	frozen_symbol_table_destroy(&frozen);
+	symbol_table_destroy(&table);
+	free(atoms);
+	free(names);
+}
+
+int main(void) {
+	for (uint32_t count = 1000; count <= 1000000; count *= 10) {
+		benchmark_symbols(count);
+	}
+	return 0;
+}
@@ -0,0 +1,106 @@
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+struct arena_block {
+	struct arena_block *previous;
+	size_t capacity;
+	size_t size;
+	char data[] __attribute__((aligned(ARENA_ALIGNMENT)));
+};
+
+static size_t align(size_t size) {
+	return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static struct arena_block *create_block(struct arena_block *previous, size_t capacity) {
+	struct arena_block *block = malloc(sizeof *block + capacity);
+	if (!block) {
+		return NULL;
+	}
+	*block = (struct arena_block){
+		.previous = previous,
+		.capacity = capacity,
+	};
+	return block;
+}
+
+// Returns true if `pointer` is the last allocation in `block`, which ends `size` bytes later.
+static bool is_last(struct arena_block *block, void *pointer, size_t size) {
+	return (char*)pointer + size == block->data + block->size;
+}
+
+struct arena arena_create(size_t block_capacity) {
+	struct arena arena = {
+		.block = create_block(NULL, align(block_capacity)),
+		.block_capacity = align(block_capacity),
+	};
+	if (!arena.block) {
+		return (struct arena){0};
+	}
+	return arena;
+}
+
+void arena_destroy(struct arena *arena) {
+	while (arena->block) {
+		struct arena_block *previous = arena->block->previous;
+		free(arena->block);
+		arena->block = previous;
+	}
+	*arena = (struct arena){0};
+}
+
+void *arena_allocate(struct arena *arena, size_t size) {
+	size = align(size);
+	struct arena_block *block = arena->block;
+	if (block->capacity - block->size < size) {
+		// Give allocations bigger than a block their own block.
+		block = create_block(block, size > arena->block_capacity ? size : arena->block_capacity);
+		if (!block) {
+			return NULL;
+		}
+		arena->block = block;
+	}
+	void *pointer = block->data + block->size;
+	block->size += size;
+	return pointer;
+}
+
+void *arena_reallocate(struct arena *arena, void *pointer, size_t size, size_t new_size) {
+	struct arena_block *block = arena->block;
+	size = align(size);
+	new_size = align(new_size);
+	size_t offset = (char*)pointer - block->data;
+	if (is_last(block, pointer, size) && new_size <= block->capacity - offset) {
+		block->size = offset + new_size;
+		return pointer;
+	}
+	if (new_size <= size) {
+		return pointer;
+	}
+	void *new_pointer = arena_allocate(arena, new_size);
+	if (!new_pointer) {
+		return NULL;
+	}
+	memcpy(new_pointer, pointer, size);
+	return new_pointer;
+}
+
+void arena_free(struct arena *arena, void *pointer, size_t size) {
+	struct arena_block *block = arena->block;
+	size = align(size);
+	if (is_last(block, pointer, size)) {
+		block->size -= size;
+	}
+}
+
+void arena_reset(struct arena *arena) {
+	while (arena->block->previous) {
+		struct arena_block *previous = arena->block->previous;
+		free(arena->block);
+		arena->block = previous;
+	}
+	arena->block->size = 0;
+}
@@ -0,0 +1,39 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Allocations are aligned to this many bytes.
+#define ARENA_ALIGNMENT 16
+
+struct arena_block;
+
+// A bump allocator that hands out memory from large blocks, so everything allocated for one
+// compilation unit can be freed at once. Not thread safe.
+struct arena {
+	struct arena_block *block; // The block allocations currently come from.
+	size_t block_capacity; // The size of new blocks, unless an allocation needs a bigger one.
+};
+
+// Returns a completely zeroed struct if a memory error occurred.
+struct arena arena_create(size_t block_capacity);
+
+void arena_destroy(struct arena *arena);
+
+// Returns null if a memory error occurred.
+void *arena_allocate(struct arena *arena, size_t size);
+
+// Resizes the `size` byte allocation at `pointer` to `new_size` bytes. It's resized in place if it's
+// the arena's last allocation and its block has room, otherwise it's copied to a new allocation.
+// Returns null and leaves the allocation alone if a memory error occurred.
+void *arena_reallocate(struct arena *arena, void *pointer, size_t size, size_t new_size);
+
+// Gives the `size` byte allocation at `pointer` back to the arena if it's the last one. Does nothing
+// otherwise; the memory is freed when the arena is reset.
+void arena_free(struct arena *arena, void *pointer, size_t size);
+
+// Frees every allocation at once, keeping the first block to allocate from again.
+void arena_reset(struct arena *arena);
+
+#endif // ARENA_H
@@ -0,0 +1,38 @@
+#include "characters.h"
+
+#define SP (CHARACTER_CLASS_SPACE | CHARACTER_CLASS_LINE_SPACE)
+#define NL CHARACTER_CLASS_SPACE
+#define DG (CHARACTER_CLASS_DIGIT | CHARACTER_CLASS_IDENTIFIER)
+#define LT (CHARACTER_CLASS_LETTER | CHARACTER_CLASS_IDENTIFIER_START | CHARACTER_CLASS_IDENTIFIER)
+#define US (CHARACTER_CLASS_IDENTIFIER_START | CHARACTER_CLASS_IDENTIFIER)
+#define CT CHARACTER_CLASS_UTF8_CONTINUATION
+#define LD CHARACTER_CLASS_UTF8_LEAD
+
+// Matches the "C" locale for ASCII characters. Bytes 0xC0, 0xC1 and 0xF5 through 0xFF never appear
+// in valid UTF-8, so they have no class.
+const unsigned char character_classes[256] = {
+	0,  0,  0,  0,  0,  0,  0,  0,  0,  SP, NL, SP, SP, SP, 0,  0,  // 0x00
+	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 0x10
+	SP, 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 0x20
+	DG, DG, DG, DG, DG, DG, DG, DG, DG, DG, 0,  0,  0,  0,  0,  0,  // 0x30
+	0,  LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, // 0x40
+	LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, 0,  0,  0,  0,  US, // 0x50
+	0,  LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, // 0x60
+	LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, 0,  0,  0,  0,  0,  // 0x70
+	CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, // 0x80
+	CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, // 0x90
+	CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, // 0xA0
+	CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, // 0xB0
+	0,  0,  LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, // 0xC0
+	LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, // 0xD0
+	LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, LD, // 0xE0
+	LD, LD, LD, LD, LD, 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 0xF0
+};
+
+#undef SP
+#undef NL
+#undef DG
+#undef LT
+#undef US
+#undef CT
+#undef LD
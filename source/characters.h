@@ -0,0 +1,26 @@
+#ifndef CHARACTERS_H
+#define CHARACTERS_H
+
+#include <stdbool.h>
+
+// Bit flags for the classes a character belongs to. A character can belong to several.
+enum character_class {
+	CHARACTER_CLASS_SPACE = 1 << 0, // Whitespace, including newlines.
+	CHARACTER_CLASS_LINE_SPACE = 1 << 1, // Whitespace that doesn't end a line.
+	CHARACTER_CLASS_DIGIT = 1 << 2,
+	CHARACTER_CLASS_LETTER = 1 << 3,
+	CHARACTER_CLASS_IDENTIFIER_START = 1 << 4, // Letters and underscores.
+	CHARACTER_CLASS_IDENTIFIER = 1 << 5, // Letters, digits, and underscores.
+	CHARACTER_CLASS_UTF8_LEAD = 1 << 6, // The first byte of a multibyte UTF-8 sequence.
+	CHARACTER_CLASS_UTF8_CONTINUATION = 1 << 7, // A byte after the first in a multibyte UTF-8 sequence.
+};
+
+// A map of bytes to the bitwise or of their character classes.
+extern const unsigned char character_classes[256];
+
+// Returns true if `character` belongs to any of the classes in `classes`.
+static inline bool character_is(char character, unsigned char classes) {
+	return character_classes[(unsigned char)character] & classes;
+}
+
+#endif // CHARACTERS_H
@@ -0,0 +1,248 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "concurrent_map.h"
+#include "arena.h"
+#include "hash.h"
+
+// Like "map.c", but groups are 8 control bytes read with one 64 bit atomic load, since readers can't
+// take the lock that would make a wider load safe. A full bucket's control byte is the low 7 bits
+// of its key's hash.
+#define GROUP_SIZE 8
+#define CONTROL_EMPTY 0x80
+
+static const uint64_t low_bits = 0x0101010101010101ull;
+
+static const uint64_t high_bits = 0x8080808080808080ull;
+
+static const size_t initial_table_capacity = 64;
+
+static const size_t arena_block_capacity = 64*1024;
+
+// Where a bucket's key and value are, plus the key's full hash. Tables only hold these, so keys and
+// values stay where they are when a shard grows.
+struct concurrent_key {
+	uint64_t hash;
+	char *value; // Points into the shard's arena, followed by the key's bytes and a null terminator.
+	size_t length;
+};
+
+struct concurrent_table {
+	size_t capacity; // A power of two, and at least `GROUP_SIZE`.
+	uint64_t *controls; // One word per group, one byte per bucket.
+	struct concurrent_key *keys;
+};
+
+// Returns the index of the shard `key_hash` belongs to. The top bits pick the shard, so the bits the
+// tables use stay evenly spread within it.
+static size_t get_shard_index(struct concurrent_map *map, uint64_t key_hash) {
+	return (key_hash >> 58) & (map->shards_count - 1);
+}
+
+// Returns a mask with the high bit set in each byte of `group` that might be `tag`. Can also set it for
+// a byte above a match, which costs a key comparison but never misses a match.
+static uint64_t match_tag(uint64_t group, uint8_t tag) {
+	uint64_t differences = group ^ (low_bits*tag);
+	return (differences - low_bits) & ~differences & high_bits;
+}
+
+static uint64_t match_empty(uint64_t group) {
+	return group & high_bits;
+}
+
+// Returns a table with `capacity` empty buckets allocated from `shard`'s arena, or null if a memory
+// error occurred. Called with `shard`'s lock held.
+static struct concurrent_table *create_table(struct concurrent_shard *shard, size_t capacity) {
+	struct concurrent_table *table = arena_allocate(&shard->arena, sizeof *table);
+	if (!table) {
+		return NULL;
+	}
+	*table = (struct concurrent_table){
+		.capacity = capacity,
+		.controls = arena_allocate(&shard->arena, capacity),
+		.keys = arena_allocate(&shard->arena, capacity*sizeof *table->keys),
+	};
+	if (!table->controls || !table->keys) {
+		return NULL;
+	}
+	memset(table->controls, CONTROL_EMPTY, capacity);
+	return table;
+}
+
+// Finds `key` in `table`. Returns its bucket index, or `SIZE_MAX` if `table` doesn't have it. Safe to
+// call while another thread adds to `table`.
+static size_t probe(struct concurrent_table *table, const char *key, size_t length, uint64_t key_hash, size_t bucket_size) {
+	size_t groups_mask = table->capacity/GROUP_SIZE - 1;
+	size_t group = (key_hash >> 7) & groups_mask;
+	for (size_t step = 1;; ++step) {
+		// Acquiring the control bytes makes the keys and values published with them visible.
+		uint64_t controls = __atomic_load_n(table->controls + group, __ATOMIC_ACQUIRE);
+		for (uint64_t matches = match_tag(controls, key_hash & 0x7F); matches; matches &= matches - 1) {
+			size_t index = group*GROUP_SIZE + __builtin_ctzll(matches)/8;
+			struct concurrent_key *entry = table->keys + index;
+			if (entry->hash == key_hash && entry->length == length && memcmp(entry->value + bucket_size, key, length) == 0) {
+				return index;
+			}
+		}
+		if (match_empty(controls)) {
+			return SIZE_MAX;
+		}
+		group = (group + step) & groups_mask;
+	}
+}
+
+// Puts `entry` in the first empty bucket on its probe sequence, then publishes the bucket. Called with
+// the shard's lock held.
+static void insert(struct concurrent_table *table, struct concurrent_key entry) {
+	size_t groups_mask = table->capacity/GROUP_SIZE - 1;
+	size_t group = (entry.hash >> 7) & groups_mask;
+	for (size_t step = 1;; ++step) {
+		uint64_t controls = __atomic_load_n(table->controls + group, __ATOMIC_RELAXED);
+		uint64_t empty = match_empty(controls);
+		if (empty) {
+			size_t offset = __builtin_ctzll(empty)/8;
+			size_t index = group*GROUP_SIZE + offset;
+			table->keys[index] = entry;
+			controls &= ~((uint64_t)0xFF << 8*offset);
+			controls |= (uint64_t)(entry.hash & 0x7F) << 8*offset;
+			__atomic_store_n(table->controls + group, controls, __ATOMIC_RELEASE);
+			return;
+		}
+		group = (group + step) & groups_mask;
+	}
+}
+
+// Doubles the capacity of `shard`'s table if another key would fill more than 7/8 of it. The old table
+// stays in the arena, so readers that loaded it before the switch can finish probing it. Called with
+// `shard`'s lock held. Returns false if a memory error occurred.
+static bool reserve(struct concurrent_shard *shard) {
+	struct concurrent_table *table = shard->table;
+	if (shard->count + 1 <= table->capacity - table->capacity/8) {
+		return true;
+	}
+	struct concurrent_table *new_table = create_table(shard, 2*table->capacity);
+	if (!new_table) {
+		return false;
+	}
+	for (size_t i = 0; i < table->capacity; ++i) {
+		if (((uint8_t*)table->controls)[i] != CONTROL_EMPTY) {
+			insert(new_table, table->keys[i]);
+		}
+	}
+	__atomic_store_n(&shard->table, new_table, __ATOMIC_RELEASE);
+	return true;
+}
+
+struct concurrent_map concurrent_map_create(size_t shards_count, size_t bucket_size) {
+	struct concurrent_map map = {
+		.shards_count = 1,
+		.bucket_size = bucket_size,
+	};
+	while (map.shards_count < shards_count && map.shards_count < CONCURRENT_MAP_MAX_SHARDS) {
+		map.shards_count *= 2;
+	}
+	void *shards;
+	if (posix_memalign(&shards, 64, map.shards_count*sizeof *map.shards) != 0) {
+		goto error1;
+	}
+	map.shards = shards;
+	size_t i = 0;
+	for (; i < map.shards_count; ++i) {
+		struct concurrent_shard *shard = map.shards + i;
+		*shard = (struct concurrent_shard){
+			.arena = arena_create(arena_block_capacity),
+		};
+		if (!shard->arena.block) {
+			goto error2;
+		}
+		shard->table = create_table(shard, initial_table_capacity);
+		// The mutex is initialized where it lives, since a mutex can't be copied.
+		if (!shard->table || pthread_mutex_init(&shard->mutex, NULL) != 0) {
+			arena_destroy(&shard->arena);
+			goto error2;
+		}
+	}
+	return map;
+
+error2:
+	while (i > 0) {
+		--i;
+		arena_destroy(&map.shards[i].arena);
+		pthread_mutex_destroy(&map.shards[i].mutex);
+	}
+	free(map.shards);
+error1:
+	return (struct concurrent_map){0};
+}
+
+void concurrent_map_destroy(struct concurrent_map *map) {
+	for (size_t i = 0; i < map->shards_count; ++i) {
+		arena_destroy(&map->shards[i].arena);
+		pthread_mutex_destroy(&map->shards[i].mutex);
+	}
+	free(map->shards);
+	*map = (struct concurrent_map){0};
+}
+
+void *concurrent_map_get(struct concurrent_map *map, const char *key, size_t length) {
+	uint64_t key_hash = hash_string(key, length);
+	struct concurrent_shard *shard = map->shards + get_shard_index(map, key_hash);
+	struct concurrent_table *table = __atomic_load_n(&shard->table, __ATOMIC_ACQUIRE);
+	size_t index = probe(table, key, length, key_hash, map->bucket_size);
+	if (index == SIZE_MAX) {
+		return NULL;
+	}
+	return table->keys[index].value;
+}
+
+void *concurrent_map_add(struct concurrent_map *map, const char *key, size_t length, const void *value) {
+	uint64_t key_hash = hash_string(key, length);
+	struct concurrent_shard *shard = map->shards + get_shard_index(map, key_hash);
+	void *result = NULL;
+	pthread_mutex_lock(&shard->mutex);
+	// Only adds change the table, and they hold the lock, so it can be read without an atomic load.
+	size_t index = probe(shard->table, key, length, key_hash, map->bucket_size);
+	if (index != SIZE_MAX) {
+		result = shard->table->keys[index].value;
+		goto unlock;
+	}
+	if (!reserve(shard)) {
+		goto unlock;
+	}
+	char *bytes = arena_allocate(&shard->arena, map->bucket_size + length + 1);
+	if (!bytes) {
+		goto unlock;
+	}
+	memcpy(bytes, value, map->bucket_size);
+	memcpy(bytes + map->bucket_size, key, length);
+	bytes[map->bucket_size + length] = '\0';
+	struct concurrent_key entry = {
+		.hash = key_hash,
+		.value = bytes,
+		.length = length,
+	};
+	insert(shard->table, entry);
+	__atomic_store_n(&shard->count, shard->count + 1, __ATOMIC_RELAXED);
+	result = bytes;
+unlock:
+	pthread_mutex_unlock(&shard->mutex);
+	return result;
+}
+
+const char *concurrent_map_get_key(struct concurrent_map *map, const void *value) {
+	return (const char*)value + map->bucket_size;
+}
+
+size_t concurrent_map_get_count(struct concurrent_map *map) {
+	size_t count = 0;
+	for (size_t i = 0; i < map->shards_count; ++i) {
+		count += __atomic_load_n(&map->shards[i].count, __ATOMIC_RELAXED);
+	}
+	return count;
+}
+
+#undef GROUP_SIZE
+#undef CONTROL_EMPTY
@@ -0,0 +1,59 @@
+#ifndef CONCURRENT_MAP_H
+#define CONCURRENT_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "arena.h"
+
+// The most shards a map can be split into.
+#define CONCURRENT_MAP_MAX_SHARDS 64
+
+struct concurrent_table;
+
+// One lock's worth of a concurrent map. Aligned to a cache line so threads adding to different shards
+// don't contend for the same line.
+struct concurrent_shard {
+	struct concurrent_table *table; // Read and written atomically.
+	size_t count;
+	struct arena arena; // Holds the keys, values and every table, so none of them move while readers use them.
+	pthread_mutex_t mutex; // Held by adds.
+} __attribute__((aligned(64)));
+
+// A map from byte string keys to values of `bucket_size` bytes that many threads can use at once.
+// Keys are hashed to one of several shards, each a Swiss table like "map.h"'s behind its own lock.
+// Lookups take no locks: an add publishes a bucket's control byte after its key and value, and
+// growing a shard publishes a new table while keeping the old one for readers still probing it.
+// Keys can't be removed, which is all the global interner needs: `lex_parallel()`'s threads find
+// identifiers that are already interned without waiting for each other.
+struct concurrent_map {
+	struct concurrent_shard *shards;
+	size_t shards_count; // A power of two.
+	size_t bucket_size;
+};
+
+// Rounds `shards_count` up to a power of two, at most `CONCURRENT_MAP_MAX_SHARDS`. Returns a
+// completely zeroed struct if a memory error occurred.
+struct concurrent_map concurrent_map_create(size_t shards_count, size_t bucket_size);
+
+// Not thread safe.
+void concurrent_map_destroy(struct concurrent_map *map);
+
+// Returns the value of the `length` byte `key`, or null if `map` doesn't have it. Takes no locks. The
+// value stays valid until `map` is destroyed.
+void *concurrent_map_get(struct concurrent_map *map, const char *key, size_t length);
+
+// Adds the `length` byte `key` with a copy of `value` unless `map` already has it. Returns the value
+// `map` ends up with, which is the existing one if another thread added the key first, or null if a
+// memory error occurred.
+void *concurrent_map_add(struct concurrent_map *map, const char *key, size_t length, const void *value);
+
+// Returns the null terminated copy of the key `value` was added with. `value` must have come from
+// `map`.
+const char *concurrent_map_get_key(struct concurrent_map *map, const void *value);
+
+// Only exact while no adds are running.
+size_t concurrent_map_get_count(struct concurrent_map *map);
+
+#endif // CONCURRENT_MAP_H
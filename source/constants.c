@@ -0,0 +1,172 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "constants.h"
+#include "lexer.h"
+#include "list.h"
+
+static const size_t initial_constants_capacity = 64;
+
+static const size_t initial_bytes_capacity = 1024;
+
+// Must be a power of two.
+static const size_t initial_slots_count = 128;
+
+// Hashes a constant with FNV-1a. Strings are hashed by their bytes, other constants by their value.
+static uint64_t hash_constant(uint8_t type, uint64_t value, const char *bytes, size_t length) {
+	uint64_t hash = 14695981039346656037u;
+	hash = (hash ^ type)*1099511628211u;
+	if (type != TOKEN_TYPE_STRING) {
+		for (size_t i = 0; i < sizeof value; ++i) {
+			hash = (hash ^ ((value >> 8*i) & 0xFF))*1099511628211u;
+		}
+		return hash;
+	}
+	for (size_t i = 0; i < length; ++i) {
+		hash = (hash ^ (unsigned char)bytes[i])*1099511628211u;
+	}
+	return hash;
+}
+
+// Returns the slot holding the given constant, or the empty slot where it belongs if `pool` doesn't
+// have it. `bytes` and `length` are only used for strings, `value` only for other constants.
+static uint32_t *find_slot(struct constant_pool *pool, uint8_t type, uint64_t value, const char *bytes, size_t length) {
+	size_t mask = list_get_count(&pool->slots) - 1;
+	for (size_t i = hash_constant(type, value, bytes, length) & mask;; i = (i + 1) & mask) {
+		if (pool->slots[i] == 0) {
+			return pool->slots + i;
+		}
+		struct constant *constant = pool->constants + pool->slots[i] - 1;
+		if (constant->type != type) {
+			continue;
+		}
+		if (type == TOKEN_TYPE_STRING ? constant->length == length && !memcmp(pool->bytes + constant->value, bytes, length) : constant->value == value) {
+			return pool->slots + i;
+		}
+	}
+}
+
+// Doubles `pool`'s hash table if another constant would fill more than half of it. Returns true if no
+// memory errors occurred.
+static bool reserve_slot(struct constant_pool *pool) {
+	size_t slots_count = list_get_count(&pool->slots);
+	if (2*(list_get_count(&pool->constants) + 1) <= slots_count) {
+		return true;
+	}
+	slots_count *= 2;
+	if (!list_set_capacity(&pool->slots, slots_count)) {
+		return false;
+	}
+	list_set_count(&pool->slots, slots_count);
+	memset(pool->slots, 0, slots_count*sizeof *pool->slots);
+	for (size_t i = 0; i < list_get_count(&pool->constants); ++i) {
+		struct constant *constant = pool->constants + i;
+		*find_slot(pool, constant->type, constant->value, pool->bytes + (constant->type == TOKEN_TYPE_STRING ? constant->value : 0), constant->length) = i + 1;
+	}
+	return true;
+}
+
+struct constant_pool constant_pool_create(void) {
+	struct constant_pool pool = {
+		.constants = list_create(initial_constants_capacity, sizeof *pool.constants),
+	};
+	if (!pool.constants) {
+		goto error1;
+	}
+	pool.bytes = list_create(initial_bytes_capacity, sizeof *pool.bytes);
+	if (!pool.bytes) {
+		goto error2;
+	}
+	pool.slots = list_create(initial_slots_count, sizeof *pool.slots);
+	if (!pool.slots) {
+		goto error3;
+	}
+	list_set_count(&pool.slots, initial_slots_count);
+	memset(pool.slots, 0, initial_slots_count*sizeof *pool.slots);
+	return pool;
+
+error3:
+	list_destroy(&pool.bytes);
+error2:
+	list_destroy(&pool.constants);
+error1:
+	return (struct constant_pool){0};
+}
+
+void constant_pool_destroy(struct constant_pool *pool) {
+	list_destroy(&pool->constants);
+	list_destroy(&pool->bytes);
+	list_destroy(&pool->slots);
+}
+
+bool constant_pool_add_value(struct constant_pool *pool, uint8_t type, uint64_t value, uint32_t *index) {
+	if (!reserve_slot(pool)) {
+		return false;
+	}
+	uint32_t *slot = find_slot(pool, type, value, NULL, 0);
+	if (!*slot) {
+		struct constant constant = {
+			.value = value,
+			.type = type,
+		};
+		if (!list_push_back(&pool->constants, &constant)) {
+			return false;
+		}
+		*slot = list_get_count(&pool->constants);
+	}
+	*index = *slot - 1;
+	return true;
+}
+
+bool constant_pool_add_string(struct constant_pool *pool, size_t bytes_index, uint32_t *index) {
+	size_t length = list_get_count(&pool->bytes) - bytes_index;
+	if (!reserve_slot(pool)) {
+		return false;
+	}
+	uint32_t *slot = find_slot(pool, TOKEN_TYPE_STRING, 0, pool->bytes + bytes_index, length);
+	if (*slot) {
+		list_set_count(&pool->bytes, bytes_index);
+	} else {
+		struct constant constant = {
+			.value = bytes_index,
+			.length = length,
+			.type = TOKEN_TYPE_STRING,
+		};
+		if (!list_push_back(&pool->constants, &constant)) {
+			return false;
+		}
+		*slot = list_get_count(&pool->constants);
+	}
+	*index = *slot - 1;
+	return true;
+}
+
+bool constant_pool_add_copy(struct constant_pool *destination, struct constant_pool *source, uint32_t source_index, uint32_t *index) {
+	struct constant constant = source->constants[source_index];
+	if (constant.type != TOKEN_TYPE_STRING) {
+		return constant_pool_add_value(destination, constant.type, constant.value, index);
+	}
+	if (!reserve_slot(destination)) {
+		return false;
+	}
+	// Look the string up before copying it, since `source` and `destination` can be the same pool.
+	uint32_t *slot = find_slot(destination, TOKEN_TYPE_STRING, 0, source->bytes + constant.value, constant.length);
+	if (!*slot) {
+		size_t bytes_index = list_get_count(&destination->bytes);
+		if (!list_append_n(&destination->bytes, source->bytes + constant.value, constant.length)) {
+			return false;
+		}
+		constant.value = bytes_index;
+		if (!list_push_back(&destination->constants, &constant)) {
+			return false;
+		}
+		*slot = list_get_count(&destination->constants);
+	}
+	*index = *slot - 1;
+	return true;
+}
+
+const char *constant_pool_get_string(struct constant_pool *pool, struct constant *constant) {
+	return pool->bytes + constant->value;
+}
@@ -0,0 +1,43 @@
+#ifndef CONSTANTS_H
+#define CONSTANTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// The decoded value of a literal token.
+struct constant {
+	uint64_t value; // A number's value, a character's code point, or the index of a string's bytes.
+	uint32_t length; // A string's length in bytes, zero for other constants.
+	uint8_t type; // `TOKEN_TYPE_NUMBER`, `TOKEN_TYPE_CHARACTER`, or `TOKEN_TYPE_STRING`.
+};
+
+// The values of a text's literals, each stored once no matter how many tokens spell it.
+struct constant_pool {
+	struct constant *constants; // Points to a list.
+	char *bytes; // Points to a list. The decoded bytes of every string, back to back.
+	uint32_t *slots; // Points to a list. A hash table of constant indices plus one, zero if empty.
+};
+
+// Returns a completely zeroed struct if a memory error occurred.
+struct constant_pool constant_pool_create(void);
+
+void constant_pool_destroy(struct constant_pool *pool);
+
+// Finds or adds the number or character constant `value`, storing its index in `index`. Returns true
+// if no memory errors occurred.
+bool constant_pool_add_value(struct constant_pool *pool, uint8_t type, uint64_t value, uint32_t *index);
+
+// Finds or adds the string made of `pool`'s bytes from `bytes_index` to the end, storing its index in
+// `index`. Those bytes are removed again if the string was already in `pool`. Returns true if no
+// memory errors occurred.
+bool constant_pool_add_string(struct constant_pool *pool, size_t bytes_index, uint32_t *index);
+
+// Finds or adds the constant at `source_index` in `source`, storing its index in `destination` in
+// `index`. Returns true if no memory errors occurred.
+bool constant_pool_add_copy(struct constant_pool *destination, struct constant_pool *source, uint32_t source_index, uint32_t *index);
+
+// Returns the bytes of the string `constant`. They aren't null terminated.
+const char *constant_pool_get_string(struct constant_pool *pool, struct constant *constant);
+
+#endif // CONSTANTS_H
@@ -0,0 +1,82 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hash.h"
+
+// GCC and Clang have 128 bit integers as an extension.
+__extension__ typedef unsigned __int128 uint128_t;
+
+static const uint64_t primes[] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull};
+
+uint64_t hash_seed;
+
+// Multiplies `a` and `b` into 128 bits and folds the halves together.
+static inline uint64_t mix(uint64_t a, uint64_t b) {
+	uint128_t product = (uint128_t)a*b;
+	return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static inline uint64_t read_64(const char *bytes) {
+	uint64_t value;
+	memcpy(&value, bytes, sizeof value);
+	return value;
+}
+
+static inline uint64_t read_32(const char *bytes) {
+	uint32_t value;
+	memcpy(&value, bytes, sizeof value);
+	return value;
+}
+
+uint64_t hash_string_seeded(const char *key, size_t length, uint64_t seed) {
+	seed ^= mix(seed ^ primes[0], primes[1]);
+	uint64_t a = 0;
+	uint64_t b = 0;
+	if (length <= 16) {
+		// Keys from 4 to 16 bytes are read as four overlapping 4 byte words, shorter ones byte by byte.
+		if (length >= 4) {
+			size_t offset = (length >> 3) << 2;
+			a = (read_32(key) << 32) | read_32(key + offset);
+			b = (read_32(key + length - 4) << 32) | read_32(key + length - 4 - offset);
+		} else if (length > 0) {
+			a = ((uint64_t)(unsigned char)key[0] << 16) | ((uint64_t)(unsigned char)key[length >> 1] << 8) | (unsigned char)key[length - 1];
+		}
+	} else {
+		size_t remaining = length;
+		while (remaining > 16) {
+			seed = mix(read_64(key) ^ primes[1], read_64(key + 8) ^ seed);
+			key += 16;
+			remaining -= 16;
+		}
+		// The last 16 bytes, which may overlap the ones already mixed in.
+		a = read_64(key + remaining - 16);
+		b = read_64(key + remaining - 8);
+	}
+	uint128_t product = (uint128_t)(a ^ primes[1])*(b ^ seed);
+	return mix((uint64_t)product ^ primes[0] ^ length, (uint64_t)(product >> 64) ^ primes[1]);
+}
+
+// FNV-1a hash, copied from Wikipedia:
+// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+uint64_t hash_fnv1a(const char *key, size_t length) {
+	uint64_t hash = 14695981039346656037ull;
+	uint64_t prime = 1099511628211ull;
+	for (size_t i = 0; i < length; ++i) {
+		hash = (hash^key[i])*prime;
+	}
+	return hash;
+}
+
+// Picks the seed before `main()` runs, so it never changes while maps use it. It only has to differ
+// between runs, not be secret, so the time, process ID, and a stack address are enough.
+__attribute__((constructor))
+static void initialize_hash_seed(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_REALTIME, &time);
+	uint64_t entropy = (uint64_t)time.tv_sec*1000000000ull + time.tv_nsec;
+	entropy ^= (uint64_t)getpid() << 32;
+	entropy ^= (uint64_t)(uintptr_t)&time;
+	hash_seed = mix(entropy ^ primes[2], primes[0]);
+}
@@ -0,0 +1,24 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hashes for string keys. `hash_string()` is seeded once per process, so a set of keys that collides
+// in one run doesn't collide in the next.
+
+// The seed `hash_string()` uses. Picked before `main()` runs.
+extern uint64_t hash_seed;
+
+// Hashes `length` bytes at `key` 8 or 16 at a time, with a mix based on wyhash:
+// https://github.com/wangyi-fudan/wyhash
+uint64_t hash_string_seeded(const char *key, size_t length, uint64_t seed);
+
+static inline uint64_t hash_string(const char *key, size_t length) {
+	return hash_string_seeded(key, length, hash_seed);
+}
+
+// Byte at a time FNV-1a, unseeded. Kept as a baseline for benchmarks.
+uint64_t hash_fnv1a(const char *key, size_t length);
+
+#endif // HASH_H
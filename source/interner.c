@@ -0,0 +1,114 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "interner.h"
+#include "concurrent_map.h"
+#include "list.h"
+
+static const size_t initial_names_capacity = 1024;
+
+static const size_t atoms_bucket_size = sizeof(uint32_t);
+
+// Adds hold the interner's lock anyway, so more shards wouldn't let them run at once.
+static const size_t atoms_shards_count = 1;
+
+static struct interner global_interner;
+
+static pthread_once_t global_interner_once = PTHREAD_ONCE_INIT;
+
+bool interner_create(struct interner *interner) {
+	*interner = (struct interner){
+		.atoms = concurrent_map_create(atoms_shards_count, atoms_bucket_size),
+	};
+	if (!interner->atoms.shards) {
+		goto error1;
+	}
+	interner->names = list_create(initial_names_capacity, sizeof *interner->names);
+	if (!interner->names) {
+		goto error2;
+	}
+	if (pthread_mutex_init(&interner->mutex, NULL) != 0) {
+		goto error3;
+	}
+	return true;
+
+error3:
+	list_destroy(&interner->names);
+error2:
+	concurrent_map_destroy(&interner->atoms);
+error1:
+	*interner = (struct interner){0};
+	return false;
+}
+
+void interner_destroy(struct interner *interner) {
+	concurrent_map_destroy(&interner->atoms);
+	list_destroy(&interner->names);
+	pthread_mutex_destroy(&interner->mutex);
+	*interner = (struct interner){0};
+}
+
+static void initialize_global_interner(void) {
+	interner_create(&global_interner);
+}
+
+struct interner *interner_get_global(void) {
+	pthread_once(&global_interner_once, initialize_global_interner);
+	return global_interner.names ? &global_interner : NULL;
+}
+
+bool interner_intern(struct interner *interner, const char *name, size_t length, uint32_t *atom) {
+	if (length > UINT32_MAX) {
+		return false;
+	}
+	uint32_t *found = concurrent_map_get(&interner->atoms, name, length);
+	if (found) {
+		*atom = *found;
+		return true;
+	}
+	// Check again with the lock held, in case another thread added the name in between.
+	bool is_successful = false;
+	pthread_mutex_lock(&interner->mutex);
+	found = concurrent_map_get(&interner->atoms, name, length);
+	if (found) {
+		*atom = *found;
+		is_successful = true;
+		goto unlock;
+	}
+	// Reserve first, so the name can't end up in the map without an entry in `names`.
+	size_t names_count = list_get_count(&interner->names);
+	if (names_count >= UINT32_MAX || !list_reserve(&interner->names, 1)) {
+		goto unlock;
+	}
+	uint32_t new_atom = names_count + 1;
+	found = concurrent_map_add(&interner->atoms, name, length, &new_atom);
+	if (!found) {
+		goto unlock;
+	}
+	struct interned_name interned = {
+		.bytes = concurrent_map_get_key(&interner->atoms, found),
+		.length = length,
+	};
+	list_push_back(&interner->names, &interned);
+	*atom = new_atom;
+	is_successful = true;
+unlock:
+	pthread_mutex_unlock(&interner->mutex);
+	return is_successful;
+}
+
+size_t interner_get_count(struct interner *interner) {
+	pthread_mutex_lock(&interner->mutex);
+	size_t count = list_get_count(&interner->names);
+	pthread_mutex_unlock(&interner->mutex);
+	return count;
+}
+
+struct interned_name interner_get_name(struct interner *interner, uint32_t atom) {
+	// The names list can move while another thread adds a name, but the bytes it points to can't.
+	pthread_mutex_lock(&interner->mutex);
+	struct interned_name name = interner->names[atom - 1];
+	pthread_mutex_unlock(&interner->mutex);
+	return name;
+}
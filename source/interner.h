@@ -0,0 +1,49 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "concurrent_map.h"
+
+// Means a token has no atom because it isn't an identifier.
+#define INTERNER_NO_ATOM 0
+
+// A name stored once by an interner.
+struct interned_name {
+	const char *bytes; // Null terminated. Never moves.
+	uint32_t length;
+};
+
+// Gives every distinct name a 32 bit atom, starting at 1, so later stages can compare and hash names
+// as integers and every name's bytes are stored once. Thread safe. Names that are already interned are
+// looked up without locks, so threads lexing identifiers at once only wait for each other to add new
+// ones.
+struct interner {
+	struct concurrent_map atoms; // Maps each name to its atom, and holds the names' bytes.
+	struct interned_name *names; // Points to a list. Atom `i`'s name is at index `i - 1`.
+	pthread_mutex_t mutex; // Held while adding names and while reading `names`, which can move.
+};
+
+// Creates an interner in place, since a mutex can't be copied once it's initialized. Returns false and
+// leaves `interner` completely zeroed if an error occurred.
+bool interner_create(struct interner *interner);
+
+void interner_destroy(struct interner *interner);
+
+// Returns the interner the whole compiler shares, such as the lexer for identifiers. It's created on
+// first use and lives until the process exits. Returns null if a memory error occurred.
+struct interner *interner_get_global(void);
+
+// Finds or adds the `length` bytes at `name`, storing its atom in `atom`. Returns true if no memory
+// errors occurred.
+bool interner_intern(struct interner *interner, const char *name, size_t length, uint32_t *atom);
+
+// Returns the number of atoms `interner` has handed out.
+size_t interner_get_count(struct interner *interner);
+
+// Assumes `atom` came from `interner`. The name stays valid until `interner` is destroyed.
+struct interned_name interner_get_name(struct interner *interner, uint32_t atom);
+
+#endif // INTERNER_H
@@ -1,16 +1,28 @@
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
-#include <ctype.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
 #include "lexer.h"
+#include "token_columns.h"
 #include "list.h"
+#include "scan.h"
+#include "characters.h"
 
-#define max(a, b) (((a) >= (b)) ? (a) : (b))
-
-static const size_t initial_tokens_capacity = 5000;
+LIST_DEFINE(char_list, char)
+LIST_DEFINE(uint32_list, uint32_t)
 
 static const size_t initial_errors_capacity = 100;
 
+// Typical code has about one token for every 8 characters and one line for every 40.
+static const size_t characters_per_token = 8;
+
+static const size_t characters_per_line = 40;
+
+static const size_t initial_relexed_tokens_capacity = 64;
+
 const char *const token_type_names[] = {
 	// Literals
 	[TOKEN_TYPE_NUMBER] = "number",
@@ -97,27 +109,285 @@ const char *const token_type_names[] = {
 	[TOKEN_TYPE_NEWLINE] = "newline",
 };
 
+// Must be a power of two.
+#define KEYWORD_TABLE_SIZE 128
+
+// A perfect hash of a keyword's length and first and last characters. The multipliers were found
+// by brute force search; adding a keyword may require finding new ones. Collisions show up as
+// `-Woverride-init` warnings on `keyword_table`.
+#define keyword_hash(length, first, last) (((length) + 3*(size_t)(first) + 21*(size_t)(last))%KEYWORD_TABLE_SIZE)
+
+// A map of keyword hashes to keyword types. Empty slots are zero, which isn't a keyword type.
+static const unsigned char keyword_table[KEYWORD_TABLE_SIZE] = {
+	[keyword_hash(9, 'n', 'e')] = TOKEN_TYPE_NAMESPACE,
+	[keyword_hash(5, 'u', 'g')] = TOKEN_TYPE_USING,
+	[keyword_hash(3, 'v', 'r')] = TOKEN_TYPE_VAR,
+	[keyword_hash(4, 'f', 'c')] = TOKEN_TYPE_FUNC,
+	[keyword_hash(6, 'm', 'd')] = TOKEN_TYPE_METHOD,
+	[keyword_hash(6, 's', 't')] = TOKEN_TYPE_STRUCT,
+	[keyword_hash(5, 't', 't')] = TOKEN_TYPE_TRAIT,
+	[keyword_hash(5, 'c', 's')] = TOKEN_TYPE_CASES,
+	[keyword_hash(3, 'p', 'b')] = TOKEN_TYPE_PUB,
+	[keyword_hash(3, 'm', 't')] = TOKEN_TYPE_MUT,
+	[keyword_hash(5, 'o', 'd')] = TOKEN_TYPE_OWNED,
+	[keyword_hash(4, 'w', 'k')] = TOKEN_TYPE_WEAK,
+	[keyword_hash(2, 'a', 's')] = TOKEN_TYPE_AS,
+	[keyword_hash(2, 'i', 's')] = TOKEN_TYPE_IS,
+	[keyword_hash(3, 'a', 'd')] = TOKEN_TYPE_BOOLEAN_AND,
+	[keyword_hash(2, 'o', 'r')] = TOKEN_TYPE_BOOLEAN_OR,
+	[keyword_hash(3, 'x', 'r')] = TOKEN_TYPE_BOOLEAN_XOR,
+	[keyword_hash(3, 'n', 't')] = TOKEN_TYPE_BOOLEAN_NOT,
+	[keyword_hash(6, 'r', 'n')] = TOKEN_TYPE_RETURN,
+	[keyword_hash(5, 'b', 'k')] = TOKEN_TYPE_BREAK,
+	[keyword_hash(8, 'c', 'e')] = TOKEN_TYPE_CONTINUE,
+	[keyword_hash(4, 'n', 't')] = TOKEN_TYPE_NEXT,
+	[keyword_hash(2, 'd', 'o')] = TOKEN_TYPE_DO,
+	[keyword_hash(5, 'w', 'e')] = TOKEN_TYPE_WHILE,
+	[keyword_hash(3, 'f', 'r')] = TOKEN_TYPE_FOR,
+	[keyword_hash(2, 'i', 'n')] = TOKEN_TYPE_IN,
+	[keyword_hash(4, 't', 'u')] = TOKEN_TYPE_THRU,
+	[keyword_hash(5, 'u', 'l')] = TOKEN_TYPE_UNTIL,
+	[keyword_hash(2, 'b', 'y')] = TOKEN_TYPE_BY,
+	[keyword_hash(2, 'i', 'f')] = TOKEN_TYPE_IF,
+	[keyword_hash(4, 'e', 'e')] = TOKEN_TYPE_ELSE,
+	[keyword_hash(6, 's', 'h')] = TOKEN_TYPE_SWITCH,
+	[keyword_hash(4, 'c', 'e')] = TOKEN_TYPE_CASE,
+	[keyword_hash(7, 'd', 't')] = TOKEN_TYPE_DEFAULT,
+};
+
+// Limits for the operator state machine. There is one column per distinct operator character and at
+// most one state per operator character.
+#define OPERATOR_COLUMNS_CAPACITY 32
+#define OPERATOR_STATES_CAPACITY 64
+
+// A map of characters to their column in `operator_transitions` plus 1. Characters that can't appear
+// in an operator map to 0.
+static unsigned char operator_columns[256];
+
+// The operator state machine, a trie of the operators' names. State 0 is the start state, so a
+// transition to 0 means there is no transition.
+static unsigned char operator_transitions[OPERATOR_STATES_CAPACITY][OPERATOR_COLUMNS_CAPACITY];
+
+// A map of states to the operator recognized by stopping in that state. 0 means the state doesn't
+// complete an operator.
+static unsigned char operator_state_types[OPERATOR_STATES_CAPACITY];
+
 const char *const lexer_error_messages[] = {
 	[LEXER_ERROR_TYPE_UNRECOGNIZED_TOKEN] = "Unrecognized token.",
 	[LEXER_ERROR_TYPE_UNCLOSED_SINGLE_QUOTE] = "Unclosed single quote.",
 	[LEXER_ERROR_TYPE_UNCLOSED_DOUBLE_QUOTE] = "Unclosed double quote.",
+	[LEXER_ERROR_TYPE_UNKNOWN_ESCAPE_SEQUENCE] = "Unknown escape sequence.",
+	[LEXER_ERROR_TYPE_INVALID_CHARACTER_LENGTH] = "Character literals must contain exactly one character.",
+	[LEXER_ERROR_TYPE_NUMBER_TOO_LARGE] = "Number is too large.",
 };
 
-bool lex(char *text, struct token **tokens, struct lexer_error **errors) {
-	*tokens = list_create(initial_tokens_capacity, sizeof **tokens);
-	if (!*tokens) {
+enum token_type lookup_keyword(const char *text, size_t length) {
+	if (length == 0) {
+		return TOKEN_TYPE_IDENTIFIER;
+	}
+	enum token_type type = keyword_table[keyword_hash(length, (unsigned char)text[0], (unsigned char)text[length - 1])];
+	// `strncmp()` stops at the end of the keyword's name, so checking the terminator afterwards is safe.
+	if (type < TOKEN_TYPE_NAMESPACE || strncmp(token_type_names[type], text, length) != 0 || token_type_names[type][length] != '\0') {
+		return TOKEN_TYPE_IDENTIFIER;
+	}
+	return type;
+}
+
+// Builds the operator state machine from the names in `token_type_names`, so the order of the
+// operators in `enum token_type` doesn't matter.
+static void initialize_operator_states(void) {
+	size_t columns_count = 0;
+	size_t states_count = 1;
+	for (size_t type = TOKEN_TYPE_DOT; type < TOKEN_TYPE_LEFT_ANGLE_BRACKET; ++type) {
+		size_t state = 0;
+		for (const char *character = token_type_names[type]; *character; ++character) {
+			unsigned char *column = operator_columns + (unsigned char)*character;
+			if (*column == 0) {
+				assert(columns_count < OPERATOR_COLUMNS_CAPACITY);
+				*column = ++columns_count;
+			}
+			unsigned char *next_state = &operator_transitions[state][*column - 1];
+			if (*next_state == 0) {
+				assert(states_count < OPERATOR_STATES_CAPACITY);
+				*next_state = states_count++;
+			}
+			state = *next_state;
+		}
+		operator_state_types[state] = type;
+	}
+}
+
+// Finds the longest operator at the start of the text between `text` and `end`. Returns true and
+// sets `type` and `length` if there is one, returns false otherwise.
+static bool match_operator(const char *text, const char *end, enum token_type *type, size_t *length) {
+	size_t state = 0;
+	size_t matched_length = 0;
+	for (size_t i = 0; text + i < end; ++i) {
+		unsigned char column = operator_columns[(unsigned char)text[i]];
+		if (column == 0 || operator_transitions[state][column - 1] == 0) {
+			break;
+		}
+		state = operator_transitions[state][column - 1];
+		if (operator_state_types[state]) {
+			*type = operator_state_types[state];
+			matched_length = i + 1;
+		}
+	}
+	*length = matched_length;
+	return matched_length > 0;
+}
+
+// A thread lexing one chunk of the text for `lex_parallel()`.
+struct lexer_thread {
+	pthread_t thread;
+	struct lexer lexer;
+	struct token_columns tokens;
+	bool is_running;
+	bool is_successful; // False if a memory error occurred.
+};
+
+// The smallest chunk worth giving its own thread.
+static const size_t minimum_chunk_length = 64*1024;
+
+static pthread_once_t operator_states_once = PTHREAD_ONCE_INIT;
+
+// `lexer_create()` with room for the line starts of `lexed_length` characters, for lexers that only
+// lex part of the text. If `constants` isn't null, the lexer adds to it instead of creating a pool, and
+// the caller takes it back from the lexer afterwards.
+static struct lexer create_lexer(const char *text, size_t text_length, size_t lexed_length, struct constant_pool *constants) {
+	struct interner *interner = interner_get_global();
+	if (text_length > UINT32_MAX || !interner) {
+		return (struct lexer){0};
+	}
+	struct lexer lexer = {
+		.text = text,
+		.end = text + text_length,
+		.interner = interner,
+		.errors = list_create(initial_errors_capacity, sizeof *lexer.errors),
+	};
+	if (!lexer.errors) {
+		return (struct lexer){0};
+	}
+	lexer.line_starts = list_create(lexed_length/characters_per_line + 16, sizeof *lexer.line_starts);
+	if (!lexer.line_starts) {
+		list_destroy(&lexer.errors);
+		return (struct lexer){0};
+	}
+	lexer.constants = constants ? *constants : constant_pool_create();
+	if (!lexer.constants.constants) {
+		list_destroy(&lexer.line_starts);
+		list_destroy(&lexer.errors);
+		return (struct lexer){0};
+	}
+	pthread_once(&operator_states_once, initialize_operator_states);
+	return lexer;
+}
+
+struct lexer lexer_create(const char *text, size_t text_length) {
+	return create_lexer(text, text_length, text_length, NULL);
+}
+
+// Decodes the escape sequence at `text`, which starts with a backslash, into `byte`. Returns the
+// number of characters it spans. An unknown escape sequence stands for the escaped character, and sets
+// `is_out_of_memory` if its error couldn't be added.
+static size_t lexer_decode_escape(struct lexer *lexer, const char *text, const char *end, char *byte) {
+	// Leave a backslash at the end of a line for the caller to report as an unclosed literal.
+	if (text + 1 == end || text[1] == '\n' || text[1] == '\r') {
+		*byte = '\\';
+		return 1;
+	}
+	switch (text[1]) {
+		case 'n':
+			*byte = '\n';
+			break;
+		case 'r':
+			*byte = '\r';
+			break;
+		case 't':
+			*byte = '\t';
+			break;
+		case '0':
+			*byte = '\0';
+			break;
+		case '\\':
+		case '\'':
+		case '"':
+			*byte = text[1];
+			break;
+		default: {
+			struct lexer_error error = {
+				.type = LEXER_ERROR_TYPE_UNKNOWN_ESCAPE_SEQUENCE,
+				.text_index = text - lexer->text,
+				.text_length = 2,
+			};
+			if (!list_push_back(&lexer->errors, &error)) {
+				lexer->is_out_of_memory = true;
+			}
+			*byte = text[1];
+			break;
+		}
+	}
+	return 2;
+}
+
+// Decodes the quoted literal at `text` onto the end of the lexer's constant bytes, stopping at the
+// closing quote or the end of the line. Returns the number of characters read, including the opening
+// quote. Sets `is_out_of_memory` and stops early if a memory error occurred.
+static size_t lexer_decode_quoted(struct lexer *lexer, const char *text, const char *end) {
+	const char *current = text + 1;
+	while (current < end && *current != *text && *current != '\r' && *current != '\n') {
+		char byte = *current;
+		size_t length = 1;
+		if (byte == '\\') {
+			length = lexer_decode_escape(lexer, current, end, &byte);
+		}
+		if (lexer->is_out_of_memory || !char_list_push_back(&lexer->constants.bytes, byte)) {
+			lexer->is_out_of_memory = true;
+			break;
+		}
+		current += length;
+	}
+	return current - text;
+}
+
+// Returns true and stores the code point in `code_point` if the `length` bytes at `bytes` encode
+// exactly one UTF-8 character.
+static bool decode_character(const char *bytes, size_t length, uint64_t *code_point) {
+	if (length == 0) {
 		return false;
 	}
-	*errors = list_create(initial_errors_capacity, sizeof **errors);
-	if (!*errors) {
-		list_destroy(&tokens);
+	unsigned char lead = bytes[0];
+	if (lead < 0x80) {
+		*code_point = lead;
+		return length == 1;
+	}
+	size_t expected_length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+	if (length != expected_length || !character_is(bytes[0], CHARACTER_CLASS_UTF8_LEAD)) {
 		return false;
 	}
+	uint64_t value = lead & (0x7F >> length);
+	for (size_t i = 1; i < length; ++i) {
+		if (!character_is(bytes[i], CHARACTER_CLASS_UTF8_CONTINUATION)) {
+			return false;
+		}
+		value = value << 6 | (bytes[i] & 0x3F);
+	}
+	*code_point = value;
+	return true;
+}
 
-	struct token current_token = {0};
-	while (*text) {
+bool lexer_next_token(struct lexer *lexer, struct token *token) {
+	const char *text = lexer->text + lexer->current_token.text_index;
+	const char *end = lexer->end;
+	struct token current_token = lexer->current_token;
+	while (text < end) {
 		// Lex newlines.
 		if (*text == '\n') {
+			uint32_t line_start = current_token.text_index + 1;
+			if (!uint32_list_push_back(&lexer->line_starts, line_start)) {
+				lexer->is_out_of_memory = true;
+				return false;
+			}
 			if (current_token.type == TOKEN_TYPE_NEWLINE) {
 				++text;
 				++current_token.text_index;
@@ -127,125 +397,429 @@ bool lex(char *text, struct token **tokens, struct lexer_error **errors) {
 			current_token.text_length = 1;
 			current_token.type = TOKEN_TYPE_NEWLINE;
 		// Skip whitespace.
-		} else if (isspace(*text)) {
-			++text;
-			++current_token.text_index;
+		} else if (character_is(*text, CHARACTER_CLASS_SPACE)) {
+			size_t length = scan_spaces(text, end);
+			text += length;
+			current_token.text_index += length;
 			continue;
 		// Skip line comments.
-		} else if (*text == '/' && *(text + 1) == '/') {
-			do {
-				++text;
-				++current_token.text_index;
-			} while (*text && *text != '\n');
+		} else if (*text == '/' && text + 1 < end && *(text + 1) == '/') {
+			size_t length = scan_line(text, end);
+			text += length;
+			current_token.text_index += length;
 			continue;
 		// Lex numbers.
-		} else if (isdigit(*text)) {
+		} else if (character_is(*text, CHARACTER_CLASS_DIGIT)) {
+			uint64_t value = 0;
+			bool is_too_large = false;
 			do {
+				is_too_large |= __builtin_mul_overflow(value, 10, &value) || __builtin_add_overflow(value, *text - '0', &value);
 				++text;
 				++current_token.text_length;
-			} while (isdigit(*text));
+			} while (text < end && character_is(*text, CHARACTER_CLASS_DIGIT));
+			if (is_too_large) {
+				struct lexer_error error = {
+					.type = LEXER_ERROR_TYPE_NUMBER_TOO_LARGE,
+					.text_index = current_token.text_index,
+					.text_length = current_token.text_length,
+				};
+				// TODO: Handle null return value.
+				list_push_back(&lexer->errors, &error);
+				current_token.text_index += error.text_length;
+				current_token.text_length = 0;
+				continue;
+			}
+			if (!constant_pool_add_value(&lexer->constants, TOKEN_TYPE_NUMBER, value, &current_token.constant_index)) {
+				lexer->is_out_of_memory = true;
+				return false;
+			}
 			current_token.type = TOKEN_TYPE_NUMBER;
 		// Lex characters.
 		} else if (*text == '\'') {
-			do {
-				++text;
-				++current_token.text_length;
-				// TODO: Handle escape characters and check length.
-			} while (*text && *text != '\'' && *text != '\r' && *text != '\n');
-			if (*text != '\'') {
+			size_t bytes_index = list_get_count(&lexer->constants.bytes);
+			current_token.text_length = lexer_decode_quoted(lexer, text, end);
+			if (lexer->is_out_of_memory) {
+				return false;
+			}
+			text += current_token.text_length;
+			if (text == end || *text != '\'') {
 				struct lexer_error error = {
 					.type = LEXER_ERROR_TYPE_UNCLOSED_SINGLE_QUOTE,
 					.text_index = current_token.text_index,
 					.text_length = current_token.text_length,
 				};
 				// TODO: Handle null return value.
-				list_push_back(errors, &error);
+				list_push_back(&lexer->errors, &error);
+				list_set_count(&lexer->constants.bytes, bytes_index);
 				current_token.text_index += error.text_length;
 				current_token.text_length = 0;
 				continue;
 			}
 			++text;
 			++current_token.text_length;
+			// The decoded bytes are only needed to find the code point.
+			uint64_t code_point;
+			bool is_valid = decode_character(lexer->constants.bytes + bytes_index, list_get_count(&lexer->constants.bytes) - bytes_index, &code_point);
+			list_set_count(&lexer->constants.bytes, bytes_index);
+			if (!is_valid) {
+				struct lexer_error error = {
+					.type = LEXER_ERROR_TYPE_INVALID_CHARACTER_LENGTH,
+					.text_index = current_token.text_index,
+					.text_length = current_token.text_length,
+				};
+				// TODO: Handle null return value.
+				list_push_back(&lexer->errors, &error);
+				current_token.text_index += error.text_length;
+				current_token.text_length = 0;
+				continue;
+			}
+			if (!constant_pool_add_value(&lexer->constants, TOKEN_TYPE_CHARACTER, code_point, &current_token.constant_index)) {
+				lexer->is_out_of_memory = true;
+				return false;
+			}
 			current_token.type = TOKEN_TYPE_CHARACTER;
 		// Lex strings.
 		} else if (*text == '"') {
-			do {
-				++text;
-				++current_token.text_length;
-				// TODO: Handle escape characters and check length.
-			} while (*text && *text != '"' && *text != '\r' && *text != '\n');
-			if (*text != '"') {
+			size_t bytes_index = list_get_count(&lexer->constants.bytes);
+			current_token.text_length = lexer_decode_quoted(lexer, text, end);
+			if (lexer->is_out_of_memory) {
+				return false;
+			}
+			text += current_token.text_length;
+			if (text == end || *text != '"') {
 				struct lexer_error error = {
 					.type = LEXER_ERROR_TYPE_UNCLOSED_DOUBLE_QUOTE,
 					.text_index = current_token.text_index,
 					.text_length = current_token.text_length,
 				};
 				// TODO: Handle null return value.
-				list_push_back(errors, &error);
+				list_push_back(&lexer->errors, &error);
+				list_set_count(&lexer->constants.bytes, bytes_index);
 				current_token.text_index += error.text_length;
 				current_token.text_length = 0;
 				continue;
 			}
 			++text;
 			++current_token.text_length;
+			if (!constant_pool_add_string(&lexer->constants, bytes_index, &current_token.constant_index)) {
+				lexer->is_out_of_memory = true;
+				return false;
+			}
 			current_token.type = TOKEN_TYPE_STRING;
 		// Lex identifiers and keywords.
-		} else if (isalpha(*text) || *text == '_') {
-			do {
-				++text;
-				++current_token.text_length;
-			} while (isalnum(*text) || *text == '_');
-			current_token.type = TOKEN_TYPE_IDENTIFIER;
-			for (size_t i = TOKEN_TYPE_NAMESPACE; i < TOKEN_TYPE_DOT; ++i) {
-				// TODO: Store the lengths of the reserved words somewhere to avoid `strlen()`.
-				if (strncmp(token_type_names[i], text - current_token.text_length, max(strlen(token_type_names[i]), current_token.text_length)) == 0) {
-					current_token.type = i;
-					break;
-				}
+		} else if (character_is(*text, CHARACTER_CLASS_IDENTIFIER_START)) {
+			current_token.text_length = scan_identifier(text, end);
+			text += current_token.text_length;
+			current_token.type = lookup_keyword(text - current_token.text_length, current_token.text_length);
+			if (current_token.type == TOKEN_TYPE_IDENTIFIER && !interner_intern(lexer->interner, text - current_token.text_length, current_token.text_length, &current_token.atom)) {
+				lexer->is_out_of_memory = true;
+				return false;
 			}
 		// Lex operators.
 		} else {
-			bool found_operator = false;
-			for (size_t i = TOKEN_TYPE_DOT; i < TOKEN_TYPE_LEFT_ANGLE_BRACKET; ++i) {
-				// TODO: Store the lengths of the reserved words somewhere to avoid `strlen()`.
-				if (strncmp(token_type_names[i], text, strlen(token_type_names[i])) == 0) {
-					current_token.type = i;
-					current_token.text_length = strlen(token_type_names[i]);
-					text += current_token.text_length;
-					found_operator = true;
-					break;
-				}
-			}
-
-			if (!found_operator) {
+			if (!match_operator(text, end, &current_token.type, &current_token.text_length)) {
 				struct lexer_error error = {
 					.type = LEXER_ERROR_TYPE_UNRECOGNIZED_TOKEN,
 					.text_index = current_token.text_index,
 					.text_length = 0,
 				};
 				// Keep consuming characters until the next whitespace to recover from the error.
-				while (*text && !isspace(*text)) {
+				while (text < end && !character_is(*text, CHARACTER_CLASS_SPACE)) {
 					++text;
 					++error.text_length;
 				}
 				// TODO: Handle null return value.
-				list_push_back(errors, &error);
+				list_push_back(&lexer->errors, &error);
 				current_token.text_index += error.text_length;
 				current_token.text_length = 0;
 				continue;
 			}
+			text += current_token.text_length;
 
 			// Distinguish between less than operator and generic brackets.
 			if (current_token.type == TOKEN_TYPE_LESS && current_token.text_index > 0 && *(text - 2) != ' ') {
 				current_token.type = TOKEN_TYPE_LEFT_ANGLE_BRACKET;
 			}
 		}
-		// TODO: Handle null return value.
-		list_push_back(tokens, &current_token);
+		*token = current_token;
 		current_token.text_index += current_token.text_length;
 		current_token.text_length = 0;
+		current_token.constant_index = 0;
+		current_token.atom = INTERNER_NO_ATOM;
+		lexer->current_token = current_token;
+		return true;
+	}
+	lexer->current_token = current_token;
+	return false;
+}
+
+// Lexes the rest of `lexer`'s text into `tokens`. Returns true if no memory errors occurred.
+static bool lexer_lex(struct lexer *lexer, struct token_columns *tokens) {
+	struct token token;
+	while (lexer_next_token(lexer, &token)) {
+		if (!token_columns_push_back(tokens, &token)) {
+			return false;
+		}
+	}
+	return !lexer->is_out_of_memory;
+}
+
+static void *lexer_thread_run(void *argument) {
+	struct lexer_thread *thread = argument;
+	thread->is_successful = lexer_lex(&thread->lexer, &thread->tokens);
+	thread->tokens.line_starts = thread->lexer.line_starts;
+	thread->lexer.line_starts = NULL;
+	thread->tokens.constants = thread->lexer.constants;
+	thread->lexer.constants = (struct constant_pool){0};
+	return NULL;
+}
+
+bool lex(const char *text, struct token_columns *tokens, struct lexer_error **errors) {
+	return lex_n(text, strlen(text), tokens, errors);
+}
+
+bool lex_n(const char *text, size_t text_length, struct token_columns *tokens, struct lexer_error **errors) {
+	// Size the token list from the text, then give back what the estimate overshot.
+	*tokens = token_columns_create(text_length/characters_per_token + 16);
+	if (!tokens->types) {
+		return false;
 	}
+	struct lexer lexer = lexer_create(text, text_length);
+	if (!lexer.errors) {
+		token_columns_destroy(tokens);
+		return false;
+	}
+	if (!lexer_lex(&lexer, tokens)) {
+		token_columns_destroy(tokens);
+		list_destroy(&lexer.errors);
+		list_destroy(&lexer.line_starts);
+		constant_pool_destroy(&lexer.constants);
+		return false;
+	}
+	token_columns_shrink_to_fit(tokens);
+	tokens->line_starts = lexer.line_starts;
+	tokens->constants = lexer.constants;
+	*errors = lexer.errors;
 	return true;
 }
 
-#undef max
+bool lex_parallel(const char *text, size_t text_length, size_t threads_count, struct token_columns *tokens, struct lexer_error **errors) {
+	if (text_length > UINT32_MAX) {
+		return false;
+	}
+	if (threads_count > text_length/minimum_chunk_length) {
+		threads_count = text_length/minimum_chunk_length;
+	}
+	if (threads_count <= 1) {
+		return lex_n(text, text_length, tokens, errors);
+	}
+	struct lexer_thread *threads = calloc(threads_count, sizeof *threads);
+	if (!threads) {
+		return false;
+	}
+	pthread_once(&operator_states_once, initialize_operator_states);
+
+	// Split the text into chunks that each start at the beginning of a line. No token spans a
+	// newline, so every chunk lexes the same way it would as part of the whole text as long as it
+	// starts in the state the previous chunk leaves behind: at an absolute text index, right after a
+	// newline token. Starting there also merges a newline at the start of a chunk into the previous
+	// chunk's last newline, and lets `<` look at the character before the chunk.
+	const char *end = text + text_length;
+	const char *chunk_start = text;
+	bool result = true;
+	for (size_t i = 0; i < threads_count; ++i) {
+		const char *chunk_end = end;
+		if (i + 1 < threads_count) {
+			chunk_end = text + (i + 1)*(text_length/threads_count);
+			if (chunk_end < chunk_start) {
+				chunk_end = chunk_start;
+			}
+			const char *newline = memchr(chunk_end, '\n', end - chunk_end);
+			chunk_end = newline ? newline + 1 : end;
+		}
+
+		struct lexer_thread *thread = threads + i;
+		thread->tokens = token_columns_create((chunk_end - chunk_start)/characters_per_token + 16);
+		thread->lexer = create_lexer(text, text_length, chunk_end - chunk_start, NULL);
+		if (!thread->tokens.types || !thread->lexer.errors) {
+			result = false;
+			break;
+		}
+		thread->lexer.end = chunk_end;
+		thread->lexer.current_token = (struct token){
+			.text_index = chunk_start - text,
+			.type = i == 0 ? TOKEN_TYPE_NUMBER : TOKEN_TYPE_NEWLINE,
+		};
+		// Lex the chunk on this thread if another one can't be started.
+		thread->is_running = pthread_create(&thread->thread, NULL, lexer_thread_run, thread) == 0;
+		if (!thread->is_running) {
+			lexer_thread_run(thread);
+		}
+		chunk_start = chunk_end;
+	}
+
+	for (size_t i = 0; i < threads_count; ++i) {
+		if (threads[i].is_running) {
+			pthread_join(threads[i].thread, NULL);
+		}
+		// Threads that were never started because an earlier one failed haven't succeeded either.
+		result = result && threads[i].is_successful;
+	}
+	// Stitch the chunks' lists together in order, reusing the first chunk's lists. Reserving room for
+	// everything first makes each chunk a single copy.
+	if (result) {
+		size_t tokens_count = 0;
+		size_t errors_count = 0;
+		for (size_t i = 1; i < threads_count; ++i) {
+			tokens_count += token_columns_get_count(&threads[i].tokens);
+			errors_count += list_get_count(&threads[i].lexer.errors);
+		}
+		result = token_columns_reserve(&threads[0].tokens, tokens_count) && list_reserve(&threads[0].lexer.errors, errors_count);
+		for (size_t i = 1; result && i < threads_count; ++i) {
+			result = token_columns_append(&threads[0].tokens, &threads[i].tokens) && list_append_n(&threads[0].lexer.errors, threads[i].lexer.errors, list_get_count(&threads[i].lexer.errors));
+		}
+	}
+	if (result) {
+		*tokens = threads[0].tokens;
+		*errors = threads[0].lexer.errors;
+		threads[0].tokens = (struct token_columns){0};
+		threads[0].lexer.errors = NULL;
+	}
+
+	for (size_t i = 0; i < threads_count; ++i) {
+		if (threads[i].tokens.types) {
+			token_columns_destroy(&threads[i].tokens);
+		}
+		if (threads[i].lexer.errors) {
+			list_destroy(&threads[i].lexer.errors);
+		}
+		if (threads[i].lexer.line_starts) {
+			list_destroy(&threads[i].lexer.line_starts);
+		}
+		if (threads[i].lexer.constants.constants) {
+			constant_pool_destroy(&threads[i].lexer.constants);
+		}
+	}
+	free(threads);
+	return result;
+}
+
+// Returns the index of the first line start after `text_index`.
+static size_t find_line_start(uint32_t *line_starts, size_t text_index) {
+	size_t low = 0;
+	size_t high = list_get_count(&line_starts);
+	while (low < high) {
+		size_t middle = low + (high - low)/2;
+		if (line_starts[middle] <= text_index) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+bool lex_edit(const char *text, size_t text_length, struct text_edit *edit, struct token_columns *tokens, struct lexer_error **errors) {
+	ptrdiff_t text_index_delta = (ptrdiff_t)edit->inserted_length - (ptrdiff_t)edit->removed_length;
+	size_t tokens_count = token_columns_get_count(tokens);
+
+	// Find the first token at or after the edit, then back up to just after the newline before it.
+	size_t start_index = 0;
+	size_t high = tokens_count;
+	while (start_index < high) {
+		size_t middle = start_index + (high - start_index)/2;
+		if (tokens->text_indices[middle] < edit->text_index) {
+			start_index = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	while (start_index > 0 && tokens->types[start_index - 1] != TOKEN_TYPE_NEWLINE) {
+		--start_index;
+	}
+
+	struct token_columns relexed = token_columns_create(initial_relexed_tokens_capacity);
+	if (!relexed.types) {
+		return false;
+	}
+	// An edit usually relexes a line or two, so the line starts start small and the constants are added
+	// to the tokens' pool.
+	struct lexer lexer = create_lexer(text, text_length, 0, &tokens->constants);
+	if (!lexer.errors) {
+		token_columns_destroy(&relexed);
+		return false;
+	}
+	// Relex in the state lexing the whole text would be in, like `lex_parallel()` does for chunks.
+	if (start_index > 0) {
+		lexer.current_token = (struct token){
+			.text_index = tokens->text_indices[start_index - 1] + 1,
+			.type = TOKEN_TYPE_NEWLINE,
+		};
+	}
+	size_t start_text_index = lexer.current_token.text_index;
+
+	// Relex until a newline after the edit lands where an old newline token did. From there on, the
+	// old tokens only need to be shifted.
+	bool result = true;
+	size_t end_index = tokens_count;
+	size_t old_index = start_index;
+	struct token token;
+	while (result && lexer_next_token(&lexer, &token)) {
+		result = token_columns_push_back(&relexed, &token);
+		if (token.type != TOKEN_TYPE_NEWLINE || token.text_index < edit->text_index + edit->inserted_length) {
+			continue;
+		}
+		size_t old_text_index = token.text_index - text_index_delta;
+		while (old_index < tokens_count && tokens->text_indices[old_index] < old_text_index) {
+			++old_index;
+		}
+		if (old_index < tokens_count && tokens->text_indices[old_index] == old_text_index && tokens->types[old_index] == TOKEN_TYPE_NEWLINE) {
+			end_index = old_index + 1;
+			break;
+		}
+	}
+	result = result && !lexer.is_out_of_memory;
+	tokens->constants = lexer.constants;
+	size_t end_text_index = lexer.current_token.text_index;
+	size_t old_end_text_index = end_text_index - text_index_delta;
+
+	// Replace the relexed tokens, line starts, and errors, and shift the ones after them.
+	result = result && token_columns_replace(tokens, start_index, end_index - start_index, &relexed, text_index_delta);
+	if (result) {
+		size_t start = find_line_start(tokens->line_starts, start_text_index);
+		size_t end = find_line_start(tokens->line_starts, old_end_text_index);
+		size_t count = list_get_count(&lexer.line_starts);
+		result = list_replace_range(&tokens->line_starts, start, end - start, lexer.line_starts, count);
+		size_t line_starts_count = list_get_count(&tokens->line_starts);
+		for (size_t i = start + count; result && i < line_starts_count; ++i) {
+			tokens->line_starts[i] += text_index_delta;
+		}
+	}
+	if (result) {
+		size_t errors_count = list_get_count(errors);
+		size_t start = 0;
+		while (start < errors_count && (*errors)[start].text_index < start_text_index) {
+			++start;
+		}
+		size_t end = start;
+		while (end < errors_count && (*errors)[end].text_index < old_end_text_index) {
+			++end;
+		}
+		size_t count = list_get_count(&lexer.errors);
+		result = list_replace_range(errors, start, end - start, lexer.errors, count);
+		errors_count = list_get_count(errors);
+		for (size_t i = start + count; result && i < errors_count; ++i) {
+			(*errors)[i].text_index += text_index_delta;
+		}
+	}
+
+	token_columns_destroy(&relexed);
+	list_destroy(&lexer.errors);
+	list_destroy(&lexer.line_starts);
+	return result;
+}
+
+#undef OPERATOR_COLUMNS_CAPACITY
+#undef OPERATOR_STATES_CAPACITY
+#undef KEYWORD_TABLE_SIZE
+#undef keyword_hash
@@ -2,7 +2,10 @@
 #define LEXER_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include "constants.h"
+#include "interner.h"
 
 enum token_type {
 	// Literals
@@ -95,12 +98,17 @@ struct token {
 	size_t text_index;
 	size_t text_length;
 	enum token_type type;
+	uint32_t constant_index; // For literals, the index of their value in the lexer's constant pool.
+	uint32_t atom; // For identifiers, their atom in the global interner. `INTERNER_NO_ATOM` otherwise.
 };
 
 enum lexer_error_type {
 	LEXER_ERROR_TYPE_UNRECOGNIZED_TOKEN,
 	LEXER_ERROR_TYPE_UNCLOSED_SINGLE_QUOTE,
 	LEXER_ERROR_TYPE_UNCLOSED_DOUBLE_QUOTE,
+	LEXER_ERROR_TYPE_UNKNOWN_ESCAPE_SEQUENCE,
+	LEXER_ERROR_TYPE_INVALID_CHARACTER_LENGTH,
+	LEXER_ERROR_TYPE_NUMBER_TOO_LARGE,
 	LEXER_ERROR_TYPE_COUNT,
 };
 
@@ -110,13 +118,67 @@ struct lexer_error {
 	enum lexer_error_type type;
 };
 
+// State for lexing a range of text one token at a time. Lexing can start at any line.
+struct lexer {
+	const char *text; // The whole text. Token indices are relative to it.
+	const char *end; // Where lexing stops.
+	struct token current_token; // `text_index` is where lexing continues, `type` is the last token's type.
+	struct lexer_error *errors; // Points to a list.
+	uint32_t *line_starts; // Points to a list. The text index after each newline.
+	struct constant_pool constants; // The decoded values of the literals lexed so far.
+	struct interner *interner; // The global interner, which identifiers are added to.
+	bool is_out_of_memory; // Set when `lexer_next_token()` returned false because of a memory error.
+};
+
+// An edit that replaced the `removed_length` characters at `text_index` with `inserted_length` new
+// ones.
+struct text_edit {
+	size_t text_index;
+	size_t removed_length;
+	size_t inserted_length;
+};
+
+// Defined in "token_columns.h".
+struct token_columns;
+
 // A map of token types to their names.
 extern const char *const token_type_names[];
 
 // A map from lexer error types to error messages.
 extern const char *const lexer_error_messages[];
 
-// Returns true if no errors were emitted.
-bool lex(char *text, struct token **tokens, struct lexer_error **errors);
+// Returns the keyword spelled by the `length` characters at `text`, or `TOKEN_TYPE_IDENTIFIER` if
+// they don't spell a keyword. Runs in constant time.
+enum token_type lookup_keyword(const char *text, size_t length);
+
+// Starts lexing the `text_length` characters at `text`. The caller owns the lexer's error list.
+// Lexing a literal decodes it into the lexer's constant pool, including escape sequences. Lexing an
+// identifier interns it in the global interner.
+// Returns a completely zeroed struct if a memory error occurred or the text is longer than 4 GiB.
+struct lexer lexer_create(const char *text, size_t text_length);
+
+// Lexes the next token into `token`, adding any errors before it to `lexer`'s error list. Returns
+// false if the text ended before another token, or if a memory error occurred, which sets
+// `is_out_of_memory`.
+bool lexer_next_token(struct lexer *lexer, struct token *token);
+
+// Lexes null terminated text. Returns true if no errors were emitted.
+bool lex(const char *text, struct token_columns *tokens, struct lexer_error **errors);
+
+// Lexes the `text_length` characters at `text`, which don't need to be null terminated. Returns true
+// if no errors were emitted.
+bool lex_n(const char *text, size_t text_length, struct token_columns *tokens, struct lexer_error **errors);
+
+// Lexes like `lex_n()`, but splits the text into chunks at newlines and lexes them on up to
+// `threads_count` threads. Produces the same tokens, errors, and return value as `lex_n()`.
+bool lex_parallel(const char *text, size_t text_length, size_t threads_count, struct token_columns *tokens, struct lexer_error **errors);
+
+// Updates the tokens and errors lexed from some text to match the `text_length` characters at
+// `text`, which are that text after `edit`. Only relexes from the last newline before the edit to
+// the first newline after it where the tokens line up with the old ones again, then shifts the rest.
+// `tokens` must have come from the lexer. Constants that are no longer used stay in the constant
+// pool. Returns true if no memory errors occurred, otherwise `tokens` and `errors` need to be lexed
+// again from the start.
+bool lex_edit(const char *text, size_t text_length, struct text_edit *edit, struct token_columns *tokens, struct lexer_error **errors);
 
 #endif // LEXER_H
@@ -3,26 +3,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include "list.h"
-
-struct list_header {
-	size_t buckets_capacity;
-	size_t buckets_count;
-	size_t bucket_size;
-	char buckets[];
-};
+#include "arena.h"
 
 const size_t list_growth_factor = 2;
 
-static struct list_header *list_get_header(void **list) {
-	return (struct list_header*)*list - 1;
+void *list_create(size_t capacity, size_t bucket_size) {
+	return list_create_in_arena(NULL, capacity, bucket_size);
 }
 
-void *list_create(size_t capacity, size_t bucket_size) {
-	struct list_header *header = malloc(sizeof *header + capacity*bucket_size);
+void *list_create_in_arena(struct arena *arena, size_t capacity, size_t bucket_size) {
+	size_t size = sizeof(struct list_header) + capacity*bucket_size;
+	struct list_header *header = arena ? arena_allocate(arena, size) : malloc(size);
 	if (!header) {
 		return NULL;
 	}
 	*header = (struct list_header){
+		.arena = arena,
 		.buckets_capacity = capacity,
 		.bucket_size = bucket_size,
 	};
@@ -31,7 +27,11 @@ void *list_create(size_t capacity, size_t bucket_size) {
 
 void list_destroy_impl(void **list) {
 	struct list_header *header = list_get_header(list);
-	free(header);
+	if (header->arena) {
+		arena_free(header->arena, header, sizeof *header + header->buckets_capacity*header->bucket_size);
+	} else {
+		free(header);
+	}
 	*list = NULL;
 }
 
@@ -45,7 +45,12 @@ bool list_set_capacity_impl(void **list, size_t capacity) {
 	if (capacity < header->buckets_count) {
 		header->buckets_count = capacity;
 	}
-	header = realloc(header, sizeof *header + capacity*header->bucket_size);
+	size_t size = sizeof *header + capacity*header->bucket_size;
+	if (header->arena) {
+		header = arena_reallocate(header->arena, header, sizeof *header + header->buckets_capacity*header->bucket_size, size);
+	} else {
+		header = realloc(header, size);
+	}
 	if (!header) {
 		return false;
 	}
@@ -54,6 +59,24 @@ bool list_set_capacity_impl(void **list, size_t capacity) {
 	return true;
 }
 
+bool list_reserve_impl(void **list, size_t count) {
+	struct list_header *header = list_get_header(list);
+	size_t needed_capacity = header->buckets_count + count;
+	if (needed_capacity <= header->buckets_capacity) {
+		return true;
+	}
+	size_t capacity = list_growth_factor*header->buckets_capacity;
+	return list_set_capacity_impl(list, needed_capacity > capacity ? needed_capacity : capacity);
+}
+
+bool list_shrink_to_fit_impl(void **list) {
+	struct list_header *header = list_get_header(list);
+	if (header->buckets_count == header->buckets_capacity) {
+		return true;
+	}
+	return list_set_capacity_impl(list, header->buckets_count);
+}
+
 size_t list_get_count_impl(void **list) {
 	struct list_header *header = list_get_header(list);
 	return header->buckets_count;
@@ -87,12 +110,10 @@ bool list_is_empty_impl(void **list) {
 }
 
 void *list_insert_uninitialized_impl(void **list, size_t index) {
-	struct list_header *header = list_get_header(list);
-	// Expand the list if needed.
-	if (header->buckets_count == header->buckets_capacity && !list_set_capacity_impl(list, list_growth_factor*header->buckets_capacity)) {
+	if (!list_reserve_impl(list, 1)) {
 		return NULL;
 	}
-	header = list_get_header(list);
+	struct list_header *header = list_get_header(list);
 
 	// Move the elements after `index` one to the right if needed.
 	if (index < header->buckets_count) {
@@ -131,6 +152,26 @@ bool list_remove_range_impl(void **list, size_t start_index, size_t count) {
 	return true;
 }
 
+bool list_replace_range_impl(void **list, size_t start_index, size_t count, const void *values, size_t values_count) {
+	struct list_header *header = list_get_header(list);
+	if (start_index > header->buckets_count || start_index + count > header->buckets_count) {
+		return false;
+	}
+	size_t new_count = header->buckets_count - count + values_count;
+	if (values_count > count && !list_reserve_impl(list, values_count - count)) {
+		return false;
+	}
+	header = list_get_header(list);
+
+	// Move the elements after the range to where the new elements end.
+	if (values_count != count) {
+		memmove(header->buckets + (start_index + values_count)*header->bucket_size, header->buckets + (start_index + count)*header->bucket_size, (header->buckets_count - start_index - count)*header->bucket_size);
+	}
+	memcpy(header->buckets + start_index*header->bucket_size, values, values_count*header->bucket_size);
+	header->buckets_count = new_count;
+	return true;
+}
+
 bool list_remove_impl(void **list, size_t index) {
 	return list_remove_range_impl(list, index, 1);
 }
@@ -143,6 +184,16 @@ void *list_push_back_impl(void **list, void *value) {
 	return list_insert_impl(list, list_get_count(list), value);
 }
 
+bool list_append_n_impl(void **list, const void *values, size_t count) {
+	if (!list_reserve_impl(list, count)) {
+		return false;
+	}
+	struct list_header *header = list_get_header(list);
+	memcpy(header->buckets + header->buckets_count*header->bucket_size, values, count*header->bucket_size);
+	header->buckets_count += count;
+	return true;
+}
+
 bool list_pop_back_impl(void **list, void *result) {
 	struct list_header *header = list_get_header(list);
 	if (header->buckets_count == 0) {
@@ -12,6 +12,13 @@
 // Returns true if no memory errors occurred.
 #define list_set_capacity(list, capacity) (list_set_capacity_impl((void**)(list), (capacity)))
 
+// Makes sure `list` has room for `count` more elements, growing its capacity by at least
+// `list_growth_factor` if it has to grow. Returns true if no memory errors occurred.
+#define list_reserve(list, count) (list_reserve_impl((void**)(list), (count)))
+
+// Shrinks `list`'s capacity to its count. Returns true if no memory errors occurred.
+#define list_shrink_to_fit(list) (list_shrink_to_fit_impl((void**)(list)))
+
 #define list_get_count(list) (list_get_count_impl((void**)(list)))
 
 // Returns true if `count` is less than or equal to `list`'s capacity and no memory errors occurred,
@@ -38,6 +45,11 @@
 // nothing otherwise.
 #define list_remove_range(list, start_index, count) (list_remove_range_impl((void**)(list), (start_index), (count)))
 
+// Replaces the `count` elements starting at `start_index` with the `values_count` elements at
+// `values`, which must not point into `list`. Returns false and does nothing if the range isn't
+// inside `list` or a memory error occurred, returns true otherwise.
+#define list_replace_range(list, start_index, count, values, values_count) (list_replace_range_impl((void**)(list), (start_index), (count), (values), (values_count)))
+
 // Returns true and deletes the element at `index` if `index` is less than `list`'s count, returns
 // false and does nothing otherwise.
 #define list_remove(list, index) (list_remove_impl((void**)list, (index)))
@@ -48,19 +60,88 @@
 // Returns a pointer to the new element if no memory errors occurred, null otherwise.
 #define list_push_back(list, value) (list_push_back_impl((void**)(list), (value)))
 
+// Appends the `count` elements at `values` with a single copy. If `values` points into `list`, reserve
+// room for them first. Returns true if no memory errors occurred.
+#define list_append_n(list, values, count) (list_append_n_impl((void**)(list), (values), (count)))
+
 // Returns true and pops the end of `list` if it had an element to pop, false otherwise.
 #define list_pop_back(list, result) (list_pop_back_impl((void**)(list), (result)))
 
+// Defines a list type `name` of `type` elements as a set of `static inline` functions, so the element
+// size is a constant and pushes can inline. Typed lists are ordinary lists, so the other list
+// functions work on them too.
+#define LIST_DEFINE(name, type) \
+	static inline type *name##_create(size_t capacity) { \
+		return list_create(capacity, sizeof(type)); \
+	} \
+	static inline size_t name##_get_count(type **list) { \
+		return list_get_header((void**)list)->buckets_count; \
+	} \
+	/* Assumes `index` is less than `list`'s count. */ \
+	static inline type *name##_get(type **list, size_t index) { \
+		return *list + index; \
+	} \
+	/* Makes sure `list` has room for `count` more elements. Returns true if no memory errors occurred. */ \
+	static inline bool name##_reserve(type **list, size_t count) { \
+		struct list_header *header = list_get_header((void**)list); \
+		return __builtin_expect(header->buckets_count + count <= header->buckets_capacity, 1) || list_reserve_impl((void**)list, count); \
+	} \
+	/* Returns a pointer to the new element if no memory errors occurred, null otherwise. */ \
+	static inline type *name##_push_back(type **list, type value) { \
+		if (!name##_reserve(list, 1)) { \
+			return NULL; \
+		} \
+		type *element = *list + list_get_header((void**)list)->buckets_count++; \
+		*element = value; \
+		return element; \
+	} \
+	/* Returns true and pops the end of `list` if it had an element to pop, false otherwise. */ \
+	static inline bool name##_pop_back(type **list, type *result) { \
+		struct list_header *header = list_get_header((void**)list); \
+		if (header->buckets_count == 0) { \
+			return false; \
+		} \
+		*result = (*list)[--header->buckets_count]; \
+		return true; \
+	}
+
+// Defined in "arena.h".
+struct arena;
+
+// Every list is a pointer to its first element, right after this header.
+struct list_header {
+	struct arena *arena; // Null if the list is allocated with `malloc()`.
+	size_t buckets_capacity;
+	size_t buckets_count;
+	size_t bucket_size;
+	char buckets[];
+};
+
+static inline struct list_header *list_get_header(void **list) {
+	return (struct list_header*)*list - 1;
+}
+
 extern const size_t list_growth_factor;
 
+// `capacity` is a hint for how many elements the list will hold. Sizing it right up front avoids
+// regrowing the list.
 void *list_create(size_t capacity, size_t bucket_size);
 
+// Creates a list that allocates from `arena`, or with `malloc()` if `arena` is null. Growing the
+// list extends it in place while it's the arena's last allocation. Destroying it only gives its
+// memory back if it is, so lists in an arena are usually freed by resetting the arena.
+void *list_create_in_arena(struct arena *arena, size_t capacity, size_t bucket_size);
+
 void list_destroy_impl(void **list);
 
 size_t list_get_capacity_impl(void **list);
 
 bool list_set_capacity_impl(void **list, size_t capacity);
 
+bool list_reserve_impl(void **list, size_t count);
+
+bool list_shrink_to_fit_impl(void **list);
+
 size_t list_get_count_impl(void **list);
 
 bool list_set_count_impl(void **list, size_t count);
@@ -77,12 +158,16 @@ void *list_insert_impl(void **list, size_t index, void *value);
 
 bool list_remove_range_impl(void **list, size_t start_index, size_t count);
 
+bool list_replace_range_impl(void **list, size_t start_index, size_t count, const void *values, size_t values_count);
+
 bool list_remove_impl(void **list, size_t index);
 
 void *list_push_back_uninitialized_impl(void **list);
 
 void *list_push_back_impl(void **list, void *value);
 
+bool list_append_n_impl(void **list, const void *values, size_t count);
+
 bool list_pop_back_impl(void **list, void *result);
 
 #endif // LIST_H
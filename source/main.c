@@ -1,14 +1,18 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "lexer.h"
+#include "token_columns.h"
 #include "parser.h"
 #include "visitor.h"
 #include "list.h"
 #include "map.h"
+#include "source_file.h"
+#include "arena.h"
 
-static void print_token(char *text, struct token *token) {
+static void print_token(const char *text, struct token *token) {
 	if (token->type == TOKEN_TYPE_NEWLINE) {
 		printf("%s", token_type_names[token->type]);
 	} else {
@@ -16,35 +20,43 @@ static void print_token(char *text, struct token *token) {
 	}
 }
 
-static void print_tokens(char *text, struct token *tokens) {
-	for (size_t i = 0; i < list_get_count(&tokens); ++i) {
+static void print_tokens(const char *text, struct token_columns *tokens) {
+	for (size_t i = 0; i < token_columns_get_count(tokens); ++i) {
+		struct token token = token_columns_get(tokens, i);
 		printf("%-5zu ", i);
-		print_token(text, tokens + i);
+		print_token(text, &token);
 		printf("\n");
 	}
 }
 
-static void print_lexer_error(char *text, struct lexer_error *error) {
-	printf("%s [Character %zu `%.*s`]", lexer_error_messages[error->type], error->text_index, (int)error->text_length, text + error->text_index);
+static void print_position(struct token_columns *tokens, size_t text_index) {
+	struct text_position position = token_columns_find_position(tokens, text_index);
+	printf("%zu:%zu", position.line, position.column);
 }
 
-static void print_lexer_errors(char *text, struct lexer_error *errors) {
+static void print_lexer_error(const char *text, struct token_columns *tokens, struct lexer_error *error) {
+	printf("%s [", lexer_error_messages[error->type]);
+	print_position(tokens, error->text_index);
+	printf(" `%.*s`]", (int)error->text_length, text + error->text_index);
+}
+
+static void print_lexer_errors(const char *text, struct token_columns *tokens, struct lexer_error *errors) {
 	for (size_t i = 0; i < list_get_count(&errors); ++i) {
-		print_lexer_error(text, errors + i);
+		print_lexer_error(text, tokens, errors + i);
 		printf("\n");
 	}
 }
 
-static void print_node(char *text, struct token *tokens, struct node *nodes, size_t first_node_index, size_t depth) {
-	struct node *node = nodes + first_node_index;
+static void print_node(const char *text, struct token_columns *tokens, struct segmented_list *nodes, size_t first_node_index, size_t depth) {
+	struct node *node = segmented_list_get(nodes, first_node_index);
 	printf("%-5zu", first_node_index);
 	for (size_t i = 0; i < depth; ++i) {
 		printf("| ");
 	}
 
 	if (node->type == NODE_TYPE_TOKEN) {
-		struct token *token = tokens + node->child_index;
-		print_token(text, token);
+		struct token token = token_columns_get(tokens, node->child_index);
+		print_token(text, &token);
 		printf("  previous=%zu, next=%zu, parent=%zu, child=%zu\n", node->previous_index, node->next_index, node->parent_index, node->child_index);
 		return;
 	}
@@ -58,17 +70,20 @@ static void print_node(char *text, struct token *tokens, struct node *nodes, siz
 	size_t node_index = node->child_index;
 	do {
 		print_node(text, tokens, nodes, node_index, depth + 1);
-		node_index = nodes[node_index].next_index;
+		node_index = ((struct node*)segmented_list_get(nodes, node_index))->next_index;
 	} while (node_index != NODE_NONE);
 }
 
-static void print_parser_error(char *text, struct token *tokens, struct parser_error *error) {
-	printf("%s [Token %zu: ", parser_error_messages[error->type], error->tokens_index - 1);
-	print_token(text, tokens + error->tokens_index - 1);
+static void print_parser_error(const char *text, struct token_columns *tokens, struct parser_error *error) {
+	struct token token = token_columns_get(tokens, error->tokens_index - 1);
+	printf("%s [", parser_error_messages[error->type]);
+	print_position(tokens, token.text_index);
+	printf(" ");
+	print_token(text, &token);
 	printf("]");
 }
 
-static void print_parser_errors(char *text, struct token *tokens, struct parser_error *errors) {
+static void print_parser_errors(const char *text, struct token_columns *tokens, struct parser_error *errors) {
 	for (size_t i = 0; i < list_get_count(&errors); ++i) {
 		print_parser_error(text, tokens, errors + i);
 		printf("\n");
@@ -86,62 +101,101 @@ static void print_parser_errors(char *text, struct token *tokens, struct parser_
 // 	}
 // }
 
-static void print_compiler_errors(struct node *nodes, struct compiler_error *errors) {
+static void print_compiler_errors(struct token_columns *tokens, struct segmented_list *nodes, struct compiler_error *errors) {
 	for (size_t i = 0; i < list_get_count(&errors); ++i) {
 		struct compiler_error *error = errors + i;
-		struct node *node = nodes + error->node_index;
-		printf("%s [Node %zu: %s]\n", compiler_error_messages[error->type], error->node_index, node_type_names[node->type]);
+		struct node *node = segmented_list_get(nodes, error->node_index);
+		printf("%s [", compiler_error_messages[error->type]);
+		// A node starts where its first token does.
+		struct node *first = node;
+		while (first->type != NODE_TYPE_TOKEN && first->child_index != NODE_NONE) {
+			first = segmented_list_get(nodes, first->child_index);
+		}
+		if (first->type == NODE_TYPE_TOKEN) {
+			print_position(tokens, token_columns_get(tokens, first->child_index).text_index);
+			printf(" ");
+		}
+		printf("%s]\n", node_type_names[node->type]);
 	}
 }
 
-int main(void) {
-	char *text = "namespace ab .c\npub namespace b";
-	printf("TEXT:\n%s\n\n", text);
+int main(int argc, char **argv) {
+	// Compile the file given on the command line, or a small example if there isn't one.
+	struct source_file file = {
+		.text = "namespace ab .c\npub namespace b",
+	};
+	if (argc > 1) {
+		if (!source_file_open(argv[1], &file)) {
+			fprintf(stderr, "Couldn't open `%s`.\n", argv[1]);
+			return 1;
+		}
+	} else {
+		file.text_length = strlen(file.text);
+	}
+	const char *text = file.text;
+	printf("TEXT:\n%.*s\n\n", (int)file.text_length, text);
 
-	struct token *tokens = NULL;
+	struct token_columns tokens = {0};
 	struct lexer_error *lexer_errors = NULL;
-	lex(text, &tokens, &lexer_errors);
-	if (!tokens || !lexer_errors) {
+	long processors_count = sysconf(_SC_NPROCESSORS_ONLN);
+	lex_parallel(text, file.text_length, processors_count > 0 ? processors_count : 1, &tokens, &lexer_errors);
+	if (!tokens.types || !lexer_errors) {
 		printf("Memory error.\n");
 		// TODO: Cleanup.
 		return 1;
 	}
 	printf("TOKENS:\n");
-	printf("tokens count = %zu\n", list_get_count(&tokens));
-	print_tokens(text, tokens);
+	printf("tokens count = %zu\n", token_columns_get_count(&tokens));
+	print_tokens(text, &tokens);
 	printf("\nLEXER ERRORS:\n");
-	print_lexer_errors(text, lexer_errors);
+	print_lexer_errors(text, &tokens, lexer_errors);
 	printf("\n");
 	
-	struct node *nodes = NULL;
+	struct segmented_list nodes = {0};
 	struct parser_error *parser_errors = NULL;
-	if (!parse(tokens, &nodes, &parser_errors)) {
+	if (!parse(&tokens, &nodes, &parser_errors)) {
 		printf("FAILED PARSING\n");
 		// TODO: Cleanup.
 		return 1;
 	}
 	printf("NODES:\n");
-	printf("nodes count = %zu\n", list_get_count(&nodes));
-	print_node(text, tokens, nodes, 0, 0);
+	printf("nodes count = %zu\n", nodes.count);
+	print_node(text, &tokens, &nodes, 0, 0);
 	printf("\nPARSER ERRORS:\n");
-	print_parser_errors(text, tokens, parser_errors);
+	print_parser_errors(text, &tokens, parser_errors);
 	printf("\n");
 
-	struct compiler_error *compiler_errors = list_create(10, sizeof *compiler_errors);
+	// Everything the compiler allocates for this file comes from one arena and is freed at once.
+	struct arena arena = arena_create(64*1024);
+	if (!arena.block) {
+		// TODO: Cleanup.
+		fprintf(stderr, "Memory error.\n");
+		return 1;
+	}
+	struct compiler_error *compiler_errors = list_create_in_arena(&arena, 10, sizeof *compiler_errors);
 	if (!compiler_errors) {
 		// TODO: Cleanup.
 		fprintf(stderr, "Memory error.\n");
 		return 1;
 	}
-	initialize_symbols(text, tokens, nodes, NULL, &compiler_errors);
+	struct object object = object_create(&arena, 16, 1024);
+	if (!object.public_symbols.handles) {
+		// TODO: Cleanup.
+		fprintf(stderr, "Memory error.\n");
+		return 1;
+	}
+	initialize_symbols(text, &tokens, &nodes, &object, &compiler_errors);
 
 	printf("COMPILER ERRORS:\n");
-	print_compiler_errors(nodes, compiler_errors);
+	print_compiler_errors(&tokens, &nodes, compiler_errors);
 
-	list_destroy(&tokens);
+	token_columns_destroy(&tokens);
 	list_destroy(&lexer_errors);
-	list_destroy(&nodes);
+	segmented_list_destroy(&nodes);
 	list_destroy(&parser_errors);
-	list_destroy(&compiler_errors);
+	arena_destroy(&arena);
+	if (argc > 1) {
+		source_file_close(&file);
+	}
 	return 0;
 }
@@ -1,121 +1,292 @@
 #include <stdio.h>
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "map.h"
+#include "arena.h"
+#include "hash.h"
+
+#ifdef __x86_64__
+#include <emmintrin.h>
+#endif
 
 #define max(a, b) (((a) >= (b)) ? (a) : (b))
 
+// Buckets are split into groups, and a lookup checks a whole group's control bytes at once. Each
+// bucket's control byte is either `CONTROL_EMPTY`, `CONTROL_DELETED`, or, if the bucket is full, the
+// low 7 bits of its key's hash. Only the first two have the high bit set.
+#define GROUP_SIZE 16
+#define CONTROL_EMPTY 0x80
+#define CONTROL_DELETED 0xFE
+
+// Where a bucket's key is, plus its full hash, so probes and rehashes don't have to read the key.
+struct map_key {
+	size_t hash;
+	size_t index; // Offset by +1 into `keys`.
+	size_t length; // Not counting the null terminator.
+};
+
 struct map_header {
+	struct arena *arena; // Null if the map is allocated with `malloc()`.
 	size_t keys_capacity;
 	size_t keys_size;
+	size_t keys_removed_size; // Bytes in `keys` that belong to removed keys, reclaimed by rehashing.
 	char *keys;
-	size_t buckets_capacity;
+	size_t buckets_capacity; // A power of two, and at least `GROUP_SIZE`.
 	size_t buckets_count;
+	size_t buckets_used; // Full and deleted buckets. Kept under the maximum load, so probes can end.
 	size_t bucket_size;
-	size_t *key_indices; // Same capacity as `buckets`.
+	struct map_key *key_entries; // Same capacity as `buckets`.
+	uint8_t *controls; // Same capacity as `buckets`.
 	char buckets[];
 };
 
-// Returned by `probe` to indicate the status of a key in a map.
-enum probe_result {
-	PROBE_RESULT_KEY_FOUND,
-	PROBE_RESULT_MAP_NOT_FULL,
-	PROBE_RESULT_MAP_FULL,
-};
-
 const size_t buckets_growth_factor = 2;
 
 const size_t keys_growth_factor = 2;
 
 const size_t initial_keys_capacity = 1024;
 
+static void *allocate(struct arena *arena, size_t size) {
+	return arena ? arena_allocate(arena, size) : malloc(size);
+}
+
+static void deallocate(struct arena *arena, void *pointer, size_t size) {
+	if (arena) {
+		arena_free(arena, pointer, size);
+	} else {
+		free(pointer);
+	}
+}
+
 static struct map_header *get_header(void **map) {
 	return (struct map_header*)*map - 1;
 }
 
-// FNV-1a hash, copied from Wikipedia:
-// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
-static size_t hash(char *key) {
-	size_t hash = 14695981039346656037ull;
-	size_t prime = 1099511628211ull;
-	while (*key) {
-		hash = (hash^*key)*prime;
-		++key;
+// Returns how many buckets can be full or deleted before the map has to be rehashed: 7/8 of them.
+static size_t get_max_load(size_t capacity) {
+	return capacity - capacity/8;
+}
+
+// Returns true if the map should shrink after a removal left `count` keys. Shrinking at a quarter of
+// the capacity to a map about half full leaves room to add or remove many keys before the next rehash.
+static bool should_shrink(size_t capacity, size_t count) {
+	return capacity > GROUP_SIZE && count <= capacity/4;
+}
+
+// Returns the smallest valid capacity that is at least `capacity` and can hold `count` keys.
+static size_t round_capacity(size_t capacity, size_t count) {
+	size_t rounded = GROUP_SIZE;
+	while (rounded < capacity || get_max_load(rounded) < count) {
+		rounded *= 2;
 	}
-	return hash;
+	return rounded;
 }
 
-// Finds the corresponding bucket for `key` in `map` and places its index in `bucket_index`. Returns a
-// status indicating whether the key was found, the key was not found and the map has an empty
-// bucket, or the key was not found and the map is full.
-static enum probe_result probe(void **map, char *key, size_t *bucket_index) {
-	struct map_header *header = get_header(map);
-	size_t start_index = hash(key)%header->buckets_capacity;
-	size_t index = start_index;
-	size_t next_empty_index = 0;
-
-	// Look for a matching key or an empty bucket.
-	do {
-		if (header->key_indices[index] == 0) {
-			if (next_empty_index == 0) {
-				next_empty_index = index;
+// Returns a mask with a bit set for each bucket in the group at `controls` whose control byte is
+// `control`.
+static uint32_t match_control(const uint8_t *controls, uint8_t control) {
+#ifdef __x86_64__
+	__m128i group = _mm_loadu_si128((const __m128i*)controls);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)control)));
+#else
+	uint32_t mask = 0;
+	for (size_t i = 0; i < GROUP_SIZE; ++i) {
+		mask |= (uint32_t)(controls[i] == control) << i;
+	}
+	return mask;
+#endif
+}
+
+// Returns a mask with a bit set for each empty or deleted bucket in the group at `controls`.
+static uint32_t match_free(const uint8_t *controls) {
+#ifdef __x86_64__
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)controls));
+#else
+	uint32_t mask = 0;
+	for (size_t i = 0; i < GROUP_SIZE; ++i) {
+		mask |= (uint32_t)(controls[i] >> 7) << i;
+	}
+	return mask;
+#endif
+}
+
+// Probes the groups in triangular steps, which visits every group once when the number of groups is a
+// power of two. The high bits of the hash pick the first group, the low 7 bits are the tag.
+static size_t get_first_group(struct map_header *header, size_t key_hash) {
+	return (key_hash >> 7) & (header->buckets_capacity/GROUP_SIZE - 1);
+}
+
+static size_t get_next_group(struct map_header *header, size_t group, size_t step) {
+	return (group + step) & (header->buckets_capacity/GROUP_SIZE - 1);
+}
+
+// Returns the index of the bucket holding `key` in `map`, or `SIZE_MAX` if `map` doesn't have it.
+// Stops at the first group with an empty bucket, since `key` would have been added there. Only
+// buckets whose stored hash and length match have their key compared.
+static size_t probe(struct map_header *header, const char *key, size_t length, size_t key_hash) {
+	uint8_t tag = key_hash & 0x7F;
+	size_t group = get_first_group(header, key_hash);
+	for (size_t step = 1;; ++step) {
+		uint8_t *controls = header->controls + group*GROUP_SIZE;
+		for (uint32_t matches = match_control(controls, tag); matches; matches &= matches - 1) {
+			size_t index = group*GROUP_SIZE + __builtin_ctz(matches);
+			struct map_key *entry = header->key_entries + index;
+			if (entry->hash == key_hash && entry->length == length && memcmp(key, header->keys + entry->index - 1, length) == 0) {
+				return index;
 			}
-		// If the bucket is full and the key matches, we found the bucket.
-		} else if (strcmp(key, header->keys + header->key_indices[index] - 1) == 0) { // Subtracting 1 because key indices are offset by +1.
-			*bucket_index = index;
-			return PROBE_RESULT_KEY_FOUND;
 		}
-		// Linear probing.
-		index = (index + 1)%header->buckets_capacity;
-	} while (index != start_index);
+		if (match_control(controls, CONTROL_EMPTY)) {
+			return SIZE_MAX;
+		}
+		group = get_next_group(header, group, step);
+	}
+}
 
-	if (header->buckets_count < header->buckets_capacity) {
-		*bucket_index = next_empty_index;
-		return PROBE_RESULT_MAP_NOT_FULL;
+// Returns the index of the first empty or deleted bucket on `key_hash`'s probe sequence. There always
+// is one, since the map is never fuller than its maximum load.
+static size_t probe_free(struct map_header *header, size_t key_hash) {
+	size_t group = get_first_group(header, key_hash);
+	for (size_t step = 1;; ++step) {
+		uint32_t matches = match_free(header->controls + group*GROUP_SIZE);
+		if (matches) {
+			return group*GROUP_SIZE + __builtin_ctz(matches);
+		}
+		group = get_next_group(header, group, step);
 	}
-	*bucket_index = SIZE_MAX;
-	return PROBE_RESULT_MAP_FULL;
 }
 
-// Returns the index of the key in the string pool if successful, 0 otherwise.
-static size_t add_key(void **map, char *key) {
+// Copies the `length` bytes at `key` and a null terminator to the string pool. Returns the key's index
+// in the pool if successful, 0 otherwise.
+static size_t add_key(void **map, const char *key, size_t length) {
 	struct map_header *header = get_header(map);
-	size_t length = strlen(key) + 1; // Adding 1 to account for null terminator.
-	if (header->keys_size + length > header->keys_capacity) {
+	size_t size = length + 1; // Adding 1 to account for null terminator.
+	if (header->keys_size + size > header->keys_capacity) {
 		// Reallocate the keys if the given key is too big to fit.
-		size_t new_capacity = max(header->keys_size + length, keys_growth_factor*header->keys_capacity);
+		size_t new_capacity = max(header->keys_size + size, keys_growth_factor*header->keys_capacity);
 		if (!map_set_keys_capacity(map, new_capacity)) {
 			return 0;
 		}
 		header = get_header(map);
 	}
-	strcpy(header->keys + header->keys_size, key);
+	memcpy(header->keys + header->keys_size, key, length);
+	header->keys[header->keys_size + length] = '\0';
 	size_t previous_size = header->keys_size;
-	header->keys_size += length;
+	header->keys_size += size;
 	return previous_size + 1; // Adding 1 because 0 is a sentinal value meaning an empty bucket.
 }
 
-void *map_create(size_t buckets_capacity, size_t bucket_size, size_t keys_capacity) {
-	struct map_header *header = malloc(sizeof *header + buckets_capacity*bucket_size);
+// Fills the free bucket at `bucket_index` with the key `entry`, whose bytes are already in the pool.
+static void fill_bucket(struct map_header *header, size_t bucket_index, struct map_key entry) {
+	if (header->controls[bucket_index] == CONTROL_EMPTY) {
+		++header->buckets_used;
+	}
+	header->controls[bucket_index] = entry.hash & 0x7F;
+	header->key_entries[bucket_index] = entry;
+	++header->buckets_count;
+}
+
+// Allocates a header with `buckets_capacity` empty buckets and no keys. Returns null if a memory
+// error occurred.
+static struct map_header *create_header(struct arena *arena, size_t buckets_capacity, size_t bucket_size) {
+	struct map_header *header = allocate(arena, sizeof *header + buckets_capacity*bucket_size);
 	if (!header) {
-		return NULL;
+		goto error1;
 	}
 	*header = (struct map_header){
-		.keys_capacity = keys_capacity,
-		.keys = malloc(keys_capacity),
+		.arena = arena,
 		.buckets_capacity = buckets_capacity,
 		.bucket_size = bucket_size,
+		.key_entries = allocate(arena, buckets_capacity*sizeof *header->key_entries),
 	};
-	if (!header->keys) {
-		free(header);
+	if (!header->key_entries) {
+		goto error2;
+	}
+	header->controls = allocate(arena, buckets_capacity);
+	if (!header->controls) {
+		goto error3;
+	}
+	memset(header->controls, CONTROL_EMPTY, buckets_capacity);
+	return header;
+
+error3:
+	deallocate(arena, header->key_entries, buckets_capacity*sizeof *header->key_entries);
+error2:
+	deallocate(arena, header, sizeof *header + buckets_capacity*bucket_size);
+error1:
+	return NULL;
+}
+
+// Frees everything but the keys, in the reverse order of `create_header()`.
+static void destroy_header(struct map_header *header) {
+	deallocate(header->arena, header->controls, header->buckets_capacity);
+	deallocate(header->arena, header->key_entries, header->buckets_capacity*sizeof *header->key_entries);
+	deallocate(header->arena, header, sizeof *header + header->buckets_capacity*header->bucket_size);
+}
+
+// Moves every key in `map` into `capacity` new buckets, dropping deleted buckets. Assumes `capacity`
+// is valid and fits every key. The new buckets share the old key pool, so no key bytes are copied,
+// unless at least half of the pool is removed keys; then the live keys are packed into a new pool.
+static bool rehash(void **map, size_t capacity) {
+	struct map_header *header = get_header(map);
+	struct map_header *new_header = create_header(header->arena, capacity, header->bucket_size);
+	if (!new_header) {
+		return false;
+	}
+	bool compact = header->keys_removed_size && 2*header->keys_removed_size >= header->keys_size;
+	if (compact) {
+		new_header->keys_capacity = max(initial_keys_capacity, header->keys_size - header->keys_removed_size);
+		new_header->keys = allocate(header->arena, new_header->keys_capacity);
+		if (!new_header->keys) {
+			destroy_header(new_header);
+			return false;
+		}
+	} else {
+		new_header->keys_capacity = header->keys_capacity;
+		new_header->keys_size = header->keys_size;
+		new_header->keys_removed_size = header->keys_removed_size;
+		new_header->keys = header->keys;
+	}
+
+	// The stored hashes place every key without hashing or comparing it again.
+	for (size_t i = 0; i < header->buckets_capacity; ++i) {
+		if (header->controls[i] < CONTROL_EMPTY) {
+			struct map_key entry = header->key_entries[i];
+			if (compact) {
+				memcpy(new_header->keys + new_header->keys_size, header->keys + entry.index - 1, entry.length + 1); // Subtracting 1 because key indices are offset by +1.
+				entry.index = new_header->keys_size + 1;
+				new_header->keys_size += entry.length + 1;
+			}
+			size_t bucket_index = probe_free(new_header, entry.hash);
+			fill_bucket(new_header, bucket_index, entry);
+			memcpy(new_header->buckets + bucket_index*new_header->bucket_size, header->buckets + i*header->bucket_size, header->bucket_size);
+		}
+	}
+
+	if (compact) {
+		deallocate(header->arena, header->keys, header->keys_capacity);
+	}
+	destroy_header(header);
+	*map = &new_header->buckets;
+	return true;
+}
+
+void *map_create(size_t buckets_capacity, size_t bucket_size, size_t keys_capacity) {
+	return map_create_in_arena(NULL, buckets_capacity, bucket_size, keys_capacity);
+}
+
+void *map_create_in_arena(struct arena *arena, size_t buckets_capacity, size_t bucket_size, size_t keys_capacity) {
+	struct map_header *header = create_header(arena, round_capacity(buckets_capacity, 0), bucket_size);
+	if (!header) {
 		return NULL;
 	}
-	header->key_indices = calloc(buckets_capacity, sizeof *header->key_indices);
-	if (!header->key_indices) {
-		free(header->keys);
-		free(header->key_indices);
+	// Allocated last, so an arena can grow the keys in place until something else is allocated.
+	header->keys_capacity = keys_capacity;
+	header->keys = allocate(arena, keys_capacity);
+	if (!header->keys) {
+		destroy_header(header);
 		return NULL;
 	}
 	return &header->buckets;
@@ -123,9 +294,9 @@ void *map_create(size_t buckets_capacity, size_t bucket_size, size_t keys_capaci
 
 void map_destroy_impl(void **map) {
 	struct map_header *header = get_header(map);
-	free(header->keys);
-	free(header->key_indices);
-	free(header);
+	// Free in the reverse order of `map_create_in_arena()`, so an arena can take back all of it.
+	deallocate(header->arena, header->keys, header->keys_capacity);
+	destroy_header(header);
 	*map = NULL;
 }
 
@@ -139,31 +310,11 @@ bool map_set_buckets_capacity_impl(void **map, size_t capacity) {
 	if (capacity < header->buckets_count) {
 		return false;
 	}
+	capacity = round_capacity(capacity, header->buckets_count);
 	if (capacity == header->buckets_capacity) {
 		return true;
 	}
-	
-	void *new_map = map_create(capacity, header->bucket_size, initial_keys_capacity);
-	if (!new_map) {
-		return false;
-	}
-
-	// Rehash all of the values from the old map.
-	for (size_t i = 0; i < header->buckets_capacity; ++i) {
-		if (header->key_indices[i]) {
-			char *key = header->keys + header->key_indices[i] - 1; // Subtracting 1 because key indices are offset by +1.
-			void *value = header->buckets + i*header->bucket_size;
-			if (!map_add(&new_map, key, value)) {
-				map_destroy(&new_map);
-				return false;
-			}
-		}
-	}
-
-	void *old_map = *map;
-	*map = new_map;
-	map_destroy(&old_map);
-	return true;
+	return rehash(map, capacity);
 }
 
 size_t map_get_buckets_count_impl(void **map) {
@@ -186,7 +337,7 @@ bool map_set_keys_capacity_impl(void **map, size_t capacity) {
 	if (capacity < header->keys_size) {
 		return false;
 	}
-	char *new_keys = realloc(header->keys, capacity);
+	char *new_keys = header->arena ? arena_reallocate(header->arena, header->keys, header->keys_capacity, capacity) : realloc(header->keys, capacity);
 	if (!new_keys) {
 		return false;
 	}
@@ -211,77 +362,127 @@ bool map_is_not_empty_impl(void **map) {
 }
 
 void *map_get_impl(void **map, char *key) {
+	return map_get_n_impl(map, key, strlen(key));
+}
+
+void *map_get_n_impl(void **map, const char *key, size_t length) {
 	struct map_header *header = get_header(map);
-	size_t bucket_index = 0;
-	enum probe_result result = probe(map, key, &bucket_index);
-	if (result == PROBE_RESULT_KEY_FOUND) {
-		return header->buckets + bucket_index*header->bucket_size;
+	size_t bucket_index = probe(header, key, length, hash_string(key, length));
+	if (bucket_index == SIZE_MAX) {
+		return NULL;
 	}
-	return NULL;
+	return header->buckets + bucket_index*header->bucket_size;
 }
 
 bool map_set_impl(void **map, char *key, void *value) {
+	return map_set_n_impl(map, key, strlen(key), value);
+}
+
+bool map_set_n_impl(void **map, const char *key, size_t length, void *value) {
 	struct map_header *header = get_header(map);
-	size_t bucket_index = 0;
-	enum probe_result result = probe(map, key, &bucket_index);
-	if (result == PROBE_RESULT_KEY_FOUND) {
-		memcpy(header->buckets + bucket_index*header->bucket_size, value, header->bucket_size);
-		++header->buckets_count;
-		return true;
+	size_t bucket_index = probe(header, key, length, hash_string(key, length));
+	if (bucket_index == SIZE_MAX) {
+		return false;
 	}
-	return false;
+	memcpy(header->buckets + bucket_index*header->bucket_size, value, header->bucket_size);
+	return true;
 }
 
 bool map_add_impl(void **map, char *key, void *value) {
+	return map_add_n_impl(map, key, strlen(key), value);
+}
+
+bool map_add_n_impl(void **map, const char *key, size_t length, void *value) {
 	struct map_header *header = get_header(map);
-	size_t bucket_index = 0;
-	enum probe_result result = probe(map, key, &bucket_index);
-	if (result == PROBE_RESULT_MAP_FULL) {
-		if (!map_set_buckets_capacity_impl(map, header->buckets_capacity*buckets_growth_factor)) {
-			return false;
-		}
-		header = get_header(map);
-		result = probe(map, key, &bucket_index);
-		if (result != PROBE_RESULT_MAP_NOT_FULL) {
-			return false;
+	size_t key_hash = hash_string(key, length);
+	size_t bucket_index = probe(header, key, length, key_hash);
+	if (bucket_index == SIZE_MAX) {
+		// Rehash if there are no buckets to spare, or if the keys would have to grow while at least half
+		// of them are removed keys. Rehashing at the same capacity is enough if deleted buckets take up
+		// a lot of the map.
+		bool buckets_full = header->buckets_used + 1 > get_max_load(header->buckets_capacity);
+		bool keys_full = header->keys_size + length + 1 > header->keys_capacity;
+		if (buckets_full || (keys_full && header->keys_removed_size && 2*header->keys_removed_size >= header->keys_size)) {
+			size_t capacity = header->buckets_capacity;
+			if (buckets_full && header->buckets_count + 1 > get_max_load(capacity)/2) {
+				capacity *= buckets_growth_factor;
+			}
+			if (!rehash(map, capacity)) {
+				return false;
+			}
+			header = get_header(map);
 		}
-	}
-	// Not an else because this needs to run if the map was full.
-	if (result == PROBE_RESULT_MAP_NOT_FULL) {
-		size_t key_index = add_key(map, key);
+		size_t key_index = add_key(map, key, length);
 		if (key_index == 0) {
 			return false;
 		}
-		header->key_indices[bucket_index] = key_index;
+		header = get_header(map);
+		bucket_index = probe_free(header, key_hash);
+		fill_bucket(header, bucket_index, (struct map_key){
+			.hash = key_hash,
+			.index = key_index,
+			.length = length,
+		});
 	}
 	memcpy(header->buckets + bucket_index*header->bucket_size, value, header->bucket_size);
-	++header->buckets_count;
 	return true;
 }
 
 bool map_remove_impl(void **map, char *key) {
+	return map_remove_n_impl(map, key, strlen(key));
+}
+
+bool map_remove_n_impl(void **map, const char *key, size_t length) {
 	struct map_header *header = get_header(map);
-	size_t bucket_index = 0;
-	enum probe_result result = probe(map, key, &bucket_index);
-	if (result == PROBE_RESULT_KEY_FOUND) {
-		header->key_indices[bucket_index] = 0;
-		--header->buckets_count;
-		if (header->buckets_count && header->buckets_count <= header->buckets_capacity/buckets_growth_factor) {
-			return map_set_buckets_capacity(map, header->buckets_count);
-		}
-		return true;
+	size_t bucket_index = probe(header, key, length, hash_string(key, length));
+	if (bucket_index == SIZE_MAX) {
+		return false;
+	}
+	// If the bucket's group has an empty bucket, no probe ever went past the group, so this bucket can
+	// be empty too. Otherwise leave a deleted marker so probes for other keys keep going past it.
+	size_t group = bucket_index/GROUP_SIZE*GROUP_SIZE;
+	if (match_control(header->controls + group, CONTROL_EMPTY)) {
+		header->controls[bucket_index] = CONTROL_EMPTY;
+		--header->buckets_used;
+	} else {
+		header->controls[bucket_index] = CONTROL_DELETED;
 	}
-	return false;
+	header->keys_removed_size += header->key_entries[bucket_index].length + 1;
+	--header->buckets_count;
+	if (should_shrink(header->buckets_capacity, header->buckets_count)) {
+		// Failing to shrink leaves a working map, so it doesn't fail the removal.
+		rehash(map, round_capacity(2*header->buckets_count, header->buckets_count));
+	}
+	return true;
 }
 
 char *map_get_key_impl(void **map, void *bucket) {
 	struct map_header *header = get_header(map);
 	ptrdiff_t bucket_index = ((char*)bucket - header->buckets)/header->bucket_size;
-	size_t key_index = header->key_indices[bucket_index];
-	if (!key_index) {
+	if (header->controls[bucket_index] >= CONTROL_EMPTY) {
 		return NULL;
 	}
-	return header->keys + key_index - 1; // Subtracting 1 because key indices are offset by +1.
+	return header->keys + header->key_entries[bucket_index].index - 1; // Subtracting 1 because key indices are offset by +1.
+}
+
+size_t map_get_key_length_impl(void **map, void *bucket) {
+	struct map_header *header = get_header(map);
+	ptrdiff_t bucket_index = ((char*)bucket - header->buckets)/header->bucket_size;
+	return header->key_entries[bucket_index].length;
+}
+
+void *map_get_next_impl(void **map, void *bucket) {
+	struct map_header *header = get_header(map);
+	size_t bucket_index = bucket ? ((char*)bucket - header->buckets)/header->bucket_size + 1 : 0;
+	for (; bucket_index < header->buckets_capacity; ++bucket_index) {
+		if (header->controls[bucket_index] < CONTROL_EMPTY) {
+			return header->buckets + bucket_index*header->bucket_size;
+		}
+	}
+	return NULL;
 }
 
 #undef max
+#undef GROUP_SIZE
+#undef CONTROL_EMPTY
+#undef CONTROL_DELETED
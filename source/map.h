@@ -10,7 +10,7 @@
 #define map_get_buckets_capacity(map) (map_get_buckets_capacity_impl((void**)(map)))
 
 // If you pass a capacity smaller than the map's current count, this function does nothing and
-// returns false.
+// returns false. Otherwise the capacity is rounded up like `map_create()`'s.
 #define map_set_buckets_capacity(map, capacity) (map_set_buckets_capacity_impl((void**)(map), (capacity)))
 
 #define map_get_buckets_count(map) (map_get_buckets_count_impl((void**)(map)))
@@ -37,16 +37,46 @@
 
 #define map_remove(map, key) (map_remove_impl((void**)(map), (key)))
 
+// The `_n` versions take a key of `length` bytes that doesn't have to be null terminated, like a
+// slice of source text. The map stores its own null terminated copy.
+
+#define map_get_n(map, key, length) (map_get_n_impl((void**)(map), (key), (length)))
+
+#define map_set_n(map, key, length, value) (map_set_n_impl((void**)(map), (key), (length), (value)))
+
+#define map_add_n(map, key, length, value) (map_add_n_impl((void**)(map), (key), (length), (value)))
+
+#define map_remove_n(map, key, length) (map_remove_n_impl((void**)(map), (key), (length)))
+
 #define map_get_key(map, bucket) (map_get_key_impl((void**)(map), (bucket)))
 
+// Keys added with the `_n` functions can contain null bytes, so `strlen()` of `map_get_key()` isn't
+// always their length.
+#define map_get_key_length(map, bucket) (map_get_key_length_impl((void**)(map), (bucket)))
+
+// Returns the first full bucket after `bucket`, or the map's first full bucket if `bucket` is null.
+// Returns null when there are no more. Buckets come in no particular order, and adding or removing
+// keys while iterating can skip or repeat them.
+#define map_get_next(map, bucket) (map_get_next_impl((void**)(map), (bucket)))
+
 extern const size_t buckets_growth_factor;
 
 extern const size_t keys_growth_factor;
 
 extern const size_t initial_keys_capacity;
 
+// Defined in "arena.h".
+struct arena;
+
+// A hash map from null terminated strings to values of `bucket_size` bytes, laid out as a Swiss table:
+// a control byte per bucket holds part of its key's hash, so lookups check 16 buckets at once and
+// stop at the first group with an empty bucket. `buckets_capacity` is rounded up to a power of two
+// of at least 16, and the map grows when more than 7/8 of it is in use.
 void *map_create(size_t buckets_capacity, size_t bucket_size, size_t keys_capacity);
 
+// Creates a map that allocates from `arena`, or with `malloc()` if `arena` is null.
+void *map_create_in_arena(struct arena *arena, size_t buckets_capacity, size_t bucket_size, size_t keys_capacity);
+
 void map_destroy_impl(void **map);
 
 size_t map_get_buckets_capacity_impl(void **map);
@@ -75,6 +105,18 @@ bool map_add_impl(void **map, char *key, void *value);
 
 bool map_remove_impl(void **map, char *key);
 
+void *map_get_n_impl(void **map, const char *key, size_t length);
+
+bool map_set_n_impl(void **map, const char *key, size_t length, void *value);
+
+bool map_add_n_impl(void **map, const char *key, size_t length, void *value);
+
+bool map_remove_n_impl(void **map, const char *key, size_t length);
+
 char *map_get_key_impl(void **map, void *bucket);
 
+size_t map_get_key_length_impl(void **map, void *bucket);
+
+void *map_get_next_impl(void **map, void *bucket);
+
 #endif // MAP_H
@@ -2,61 +2,155 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include "parser.h"
 #include "lexer.h"
+#include "token_columns.h"
 #include "list.h"
+#include "segmented_list.h"
 
 // State shared between all of the parsing rules.
 struct parser {
-	struct token *tokens; // Points to a list.
+	uint8_t *token_types; // Points to a list. The parser only needs the tokens' types.
+	size_t tokens_count;
 	size_t current_token_index;
-	struct node *nodes; // Points to a list.
+	struct lexer *lexer; // Null unless streaming.
+	struct token_columns *streamed_tokens; // The tokens consumed so far when streaming.
+	struct token lookahead; // The current token when streaming. The grammar never needs to see further.
+	bool has_lookahead;
+	struct segmented_list nodes;
 	size_t last_node_index;
 	bool next_node_is_child;
+	struct syntax_tree *tree; // Null unless building a compact tree, which replaces `nodes`.
+	uint32_t *pending_children; // Points to a list. The children of the compact nodes still open.
+	uint32_t open_node_index; // The compact node new children belong to.
 	struct parser_error *errors; // Points to a list.
 };
 
-static const size_t initial_nodes_capacity = 1000;
+static const size_t nodes_chunk_capacity = 1024;
 
 static const size_t initial_errors_capacity = 100;
 
-static struct token *parser_get_current_token(struct parser *parser) {
-	if (parser->current_token_index < list_get_count(&parser->tokens)) {
-		return parser->tokens + parser->current_token_index;
+static const size_t initial_streamed_tokens_capacity = 1000;
+
+static const size_t initial_tree_nodes_capacity = 256;
+
+static const size_t initial_tree_children_capacity = 1024;
+
+// Lexes the current token if it hasn't been yet. Returns false if the text ended.
+static bool parser_fill_lookahead(struct parser *parser) {
+	if (!parser->has_lookahead) {
+		parser->has_lookahead = lexer_next_token(parser->lexer, &parser->lookahead);
+	}
+	return parser->has_lookahead;
+}
+
+static bool parser_has_tokens(struct parser *parser) {
+	if (parser->lexer) {
+		return parser_fill_lookahead(parser);
+	}
+	return parser->current_token_index < parser->tokens_count;
+}
+
+// Moves past the current token, assuming there is one. When streaming, the token is only kept if
+// `is_in_tree` is true, and `current_token_index` counts kept tokens. Returns true if no memory
+// errors occurred.
+static bool parser_advance(struct parser *parser, bool is_in_tree) {
+	if (!parser->lexer) {
+		++parser->current_token_index;
+		return true;
 	}
-	return NULL;
+	if (is_in_tree) {
+		if (!token_columns_push_back(parser->streamed_tokens, &parser->lookahead)) {
+			return false;
+		}
+		++parser->current_token_index;
+	}
+	parser->has_lookahead = false;
+	return true;
 }
 
 static bool parser_add_node(struct parser *parser, struct node *node) {
-	struct node *new_node = list_push_back_uninitialized(&parser->nodes);
+	struct node *new_node = segmented_list_push_back(&parser->nodes, node);
 	if (!new_node) {
 		return false;
 	}
-	*new_node = *node;
+	size_t new_node_index = parser->nodes.count - 1;
 
 	if (parser->last_node_index == NODE_NONE) {
-		parser->last_node_index = new_node - parser->nodes;
+		parser->last_node_index = new_node_index;
 		return true;
 	}
 
 	// Link the node to the previous node.
-	struct node *last_node = parser->nodes + parser->last_node_index;
+	struct node *last_node = segmented_list_get(&parser->nodes, parser->last_node_index);
 	if (parser->next_node_is_child) {
 		parser->next_node_is_child = false;
 		new_node->parent_index = parser->last_node_index;
-		last_node->child_index = new_node - parser->nodes;
-		parser->last_node_index = new_node - parser->nodes;
+		last_node->child_index = new_node_index;
+		parser->last_node_index = new_node_index;
 		return true;
 	}
-	new_node->previous_index = last_node - parser->nodes;
+	new_node->previous_index = parser->last_node_index;
 	new_node->parent_index = last_node->parent_index;
-	last_node->next_index = new_node - parser->nodes;
-	parser->last_node_index = new_node - parser->nodes;
+	last_node->next_index = new_node_index;
+	parser->last_node_index = new_node_index;
+	return true;
+}
+
+// Adds `reference` to the children of the open compact node, if there is one. Returns true if no
+// memory errors occurred.
+static bool parser_add_compact_child(struct parser *parser, uint32_t reference) {
+	if (parser->open_node_index == SYNTAX_TREE_NONE) {
+		return true;
+	}
+	return list_push_back(&parser->pending_children, &reference);
+}
+
+// Opens a compact node. Its children pile up on `pending_children` until it ends, and its children
+// start holds where they begin on it until then. Returns true if no memory errors occurred.
+static bool parser_begin_compact_node(struct parser *parser, enum node_type type) {
+	struct syntax_tree *tree = parser->tree;
+	size_t node_index = list_get_count(&tree->types);
+	if (node_index >= SYNTAX_TREE_TOKEN_BIT || !parser_add_compact_child(parser, node_index)) {
+		return false;
+	}
+	if (!list_reserve(&tree->types, 1) || !list_reserve(&tree->parents, 1) || !list_reserve(&tree->children_starts, 1) || !list_reserve(&tree->children_counts, 1)) {
+		return false;
+	}
+	uint8_t node_type = type;
+	uint32_t pending_start = list_get_count(&parser->pending_children);
+	uint32_t children_count = 0;
+	list_push_back(&tree->types, &node_type);
+	list_push_back(&tree->parents, &parser->open_node_index);
+	list_push_back(&tree->children_starts, &pending_start);
+	list_push_back(&tree->children_counts, &children_count);
+	parser->open_node_index = node_index;
+	return true;
+}
+
+// Moves the open compact node's children from `pending_children` to the tree, so they end up next
+// to each other even though their own children were added in between.
+static bool parser_end_compact_node(struct parser *parser) {
+	struct syntax_tree *tree = parser->tree;
+	uint32_t node_index = parser->open_node_index;
+	uint32_t pending_start = tree->children_starts[node_index];
+	uint32_t children_count = list_get_count(&parser->pending_children) - pending_start;
+	tree->children_starts[node_index] = list_get_count(&tree->children);
+	tree->children_counts[node_index] = children_count;
+	if (!list_append_n(&tree->children, parser->pending_children + pending_start, children_count)) {
+		return false;
+	}
+	list_set_count(&parser->pending_children, pending_start);
+	parser->open_node_index = tree->parents[node_index];
 	return true;
 }
 
 static bool parser_begin_node(struct parser *parser, enum node_type type) {
+	if (parser->tree) {
+		return parser_begin_compact_node(parser, type);
+	}
 	struct node new_node = {
 		.type = type,
 		.parent_index = NODE_NONE,
@@ -72,20 +166,34 @@ static bool parser_begin_node(struct parser *parser, enum node_type type) {
 }
 
 static bool parser_end_node(struct parser *parser) {
-	struct node *last_node = parser->nodes + parser->last_node_index;
+	if (parser->tree) {
+		return parser_end_compact_node(parser);
+	}
+	struct node *last_node = segmented_list_get(&parser->nodes, parser->last_node_index);
 	parser->last_node_index = last_node->parent_index;
 	return true;
 }
 
 static bool parser_peek_token(struct parser *parser, enum token_type type) {
-	struct token *token = parser_get_current_token(parser);
-	return token && token->type == type;
+	if (!parser_has_tokens(parser)) {
+		return false;
+	}
+	if (parser->lexer) {
+		return parser->lookahead.type == type;
+	}
+	return parser->token_types[parser->current_token_index] == type;
 }
 
 static bool parser_consume_token(struct parser *parser, enum token_type type) {
 	if (!parser_peek_token(parser, type)) {
 		return false;
 	}
+	if (parser->tree) {
+		if (parser->current_token_index >= SYNTAX_TREE_TOKEN_BIT || !parser_add_compact_child(parser, parser->current_token_index | SYNTAX_TREE_TOKEN_BIT)) {
+			return false;
+		}
+		return parser_advance(parser, true);
+	}
 	struct node new_node = {
 		.type = NODE_TYPE_TOKEN,
 		.parent_index = NODE_NONE,
@@ -96,8 +204,7 @@ static bool parser_consume_token(struct parser *parser, enum token_type type) {
 	if (!parser_add_node(parser, &new_node)) {
 		return false;
 	}
-	++parser->current_token_index;
-	return true;
+	return parser_advance(parser, true);
 }
 
 static bool parser_emit_error(struct parser *parser, enum parser_error_type type) {
@@ -112,18 +219,29 @@ static bool parser_emit_error(struct parser *parser, enum parser_error_type type
 		// TODO: Set `tokens_count`.
 	};
 
+	// When streaming, keep the token the error is on so `tokens_index` still refers to it.
+	if (parser->lexer && parser_has_tokens(parser)) {
+		bool is_line_end = parser_peek_token(parser, TOKEN_TYPE_NEWLINE);
+		if (!parser_advance(parser, true)) {
+			return false;
+		}
+		if (is_line_end) {
+			return parser_end_node(parser);
+		}
+	}
+
 	// Skip tokens until we pass the next newline.
-	while (parser->current_token_index < list_get_count(&parser->tokens) && !parser_peek_token(parser, TOKEN_TYPE_NEWLINE)) {
-		++parser->current_token_index;
+	while (parser_has_tokens(parser) && !parser_peek_token(parser, TOKEN_TYPE_NEWLINE)) {
+		parser_advance(parser, false);
 	}
 	if (parser_peek_token(parser, TOKEN_TYPE_NEWLINE)) {
-		++parser->current_token_index;
+		parser_advance(parser, false);
 	}
 	return parser_end_node(parser);
 }
 
 static bool parse_line_end(struct parser *parser) {
-	return parser_consume_token(parser, TOKEN_TYPE_NEWLINE) || !parser_get_current_token(parser);
+	return parser_consume_token(parser, TOKEN_TYPE_NEWLINE) || !parser_has_tokens(parser);
 }
 
 static bool parse_namespace_definition(struct parser *parser) {
@@ -153,7 +271,7 @@ static bool parse_program_statement(struct parser *parser) {
 
 static bool parse_program(struct parser *parser) {
 	parser_begin_node(parser, NODE_TYPE_PROGRAM);
-		while (parser->current_token_index < list_get_count(&parser->tokens)) {
+		while (parser_has_tokens(parser)) {
 			if (!parse_program_statement(parser)) return parser_emit_error(parser, PARSER_ERROR_TYPE_EXPECTED_STATEMENT);
 		}
 	return parser_end_node(parser);
@@ -174,26 +292,139 @@ const char *const parser_error_messages[PARSER_ERROR_TYPE_COUNT] = {
 	[PARSER_ERROR_TYPE_EXPECTED_STATEMENT] = "Expected a satatement.",
 };
 
-bool parse(struct token *tokens, struct node **nodes, struct parser_error **errors) {
+// Runs `parser`, which has its token source set up, and returns its results.
+static bool parser_run(struct parser *parser, struct segmented_list *nodes, struct parser_error **errors) {
+	parser->nodes = segmented_list_create(nodes_chunk_capacity, sizeof(struct node));
+	parser->last_node_index = NODE_NONE;
+	if (!parser->nodes.chunks) {
+		goto error1;
+	}
+	parser->errors = list_create(initial_errors_capacity, sizeof *parser->errors);
+	if (!parser->errors) {
+		goto error2;
+	}
+	bool result = parse_program(parser);
+	*nodes = parser->nodes;
+	*errors = parser->errors;
+	return result;
+
+error2:
+	segmented_list_destroy(&parser->nodes);
+error1:
+	return false;
+}
+
+bool parse(struct token_columns *tokens, struct segmented_list *nodes, struct parser_error **errors) {
 	struct parser parser = {
-		.tokens = tokens,
-		.nodes = list_create(initial_nodes_capacity, sizeof *parser.nodes),
-		.last_node_index = NODE_NONE,
+		.token_types = tokens->types,
+		.tokens_count = list_get_count(&tokens->types),
+	};
+	return parser_run(&parser, nodes, errors);
+}
+
+// Returns a completely zeroed struct if a memory error occurred.
+static struct syntax_tree syntax_tree_create(void) {
+	struct syntax_tree tree = {
+		.types = list_create(initial_tree_nodes_capacity, sizeof *tree.types),
 	};
-	if (!parser.nodes) {
+	if (!tree.types) {
 		goto error1;
 	}
+	tree.parents = list_create(initial_tree_nodes_capacity, sizeof *tree.parents);
+	if (!tree.parents) {
+		goto error2;
+	}
+	tree.children_starts = list_create(initial_tree_nodes_capacity, sizeof *tree.children_starts);
+	if (!tree.children_starts) {
+		goto error3;
+	}
+	tree.children_counts = list_create(initial_tree_nodes_capacity, sizeof *tree.children_counts);
+	if (!tree.children_counts) {
+		goto error4;
+	}
+	tree.children = list_create(initial_tree_children_capacity, sizeof *tree.children);
+	if (!tree.children) {
+		goto error5;
+	}
+	return tree;
+
+error5:
+	list_destroy(&tree.children_counts);
+error4:
+	list_destroy(&tree.children_starts);
+error3:
+	list_destroy(&tree.parents);
+error2:
+	list_destroy(&tree.types);
+error1:
+	return (struct syntax_tree){0};
+}
+
+void syntax_tree_destroy(struct syntax_tree *tree) {
+	list_destroy(&tree->types);
+	list_destroy(&tree->parents);
+	list_destroy(&tree->children_starts);
+	list_destroy(&tree->children_counts);
+	list_destroy(&tree->children);
+	*tree = (struct syntax_tree){0};
+}
+
+bool parse_compact(struct token_columns *tokens, struct syntax_tree *tree, struct parser_error **errors) {
+	*tree = syntax_tree_create();
+	if (!tree->types) {
+		goto error1;
+	}
+	struct parser parser = {
+		.token_types = tokens->types,
+		.tokens_count = list_get_count(&tokens->types),
+		.tree = tree,
+		.pending_children = list_create(initial_tree_children_capacity, sizeof *parser.pending_children),
+		.open_node_index = SYNTAX_TREE_NONE,
+	};
+	if (!parser.pending_children) {
+		goto error2;
+	}
 	parser.errors = list_create(initial_errors_capacity, sizeof *parser.errors);
 	if (!parser.errors) {
-		goto error2;
+		goto error3;
 	}
 	bool result = parse_program(&parser);
-	*nodes = parser.nodes;
+	list_destroy(&parser.pending_children);
 	*errors = parser.errors;
 	return result;
 
+error3:
+	list_destroy(&parser.pending_children);
 error2:
-	list_destroy(&parser.nodes);
+	syntax_tree_destroy(tree);
 error1:
 	return false;
 }
+
+bool parse_stream(struct lexer *lexer, struct token_columns *tokens, struct segmented_list *nodes, struct parser_error **errors) {
+	*tokens = token_columns_create(initial_streamed_tokens_capacity);
+	if (!tokens->types) {
+		return false;
+	}
+	struct parser parser = {
+		.lexer = lexer,
+		.streamed_tokens = tokens,
+	};
+	*nodes = (struct segmented_list){0};
+	bool result = parser_run(&parser, nodes, errors);
+	if (!nodes->chunks) {
+		token_columns_destroy(tokens);
+		return result;
+	}
+	// The parser can stop early, so finish lexing to record every line start.
+	struct token token;
+	while (lexer_next_token(lexer, &token)) {}
+	// The parser can't tell a memory error in the lexer from the end of the text.
+	result = result && !lexer->is_out_of_memory;
+	tokens->line_starts = lexer->line_starts;
+	lexer->line_starts = NULL;
+	tokens->constants = lexer->constants;
+	lexer->constants = (struct constant_pool){0};
+	return result;
+}
+
@@ -0,0 +1,27 @@
+#include <stddef.h>
+#include "scan.h"
+#include "characters.h"
+
+size_t scan_spaces(const char *text, const char *end) {
+	const char *current = text;
+	while (current < end && character_is(*current, CHARACTER_CLASS_LINE_SPACE)) {
+		++current;
+	}
+	return current - text;
+}
+
+size_t scan_line(const char *text, const char *end) {
+	const char *current = text;
+	while (current < end && *current != '\n') {
+		++current;
+	}
+	return current - text;
+}
+
+size_t scan_identifier(const char *text, const char *end) {
+	const char *current = text;
+	while (current < end && character_is(*current, CHARACTER_CLASS_IDENTIFIER)) {
+		++current;
+	}
+	return current - text;
+}
@@ -0,0 +1,17 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+// Functions for skipping runs of similar characters in the text between `text` and `end`.
+
+// Returns the number of whitespace characters other than newlines at the start of `text`.
+size_t scan_spaces(const char *text, const char *end);
+
+// Returns the number of characters before the next newline or `end`.
+size_t scan_line(const char *text, const char *end);
+
+// Returns the number of letters, digits, and underscores at the start of `text`.
+size_t scan_identifier(const char *text, const char *end);
+
+#endif // SCAN_H
@@ -0,0 +1,55 @@
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "segmented_list.h"
+#include "list.h"
+
+static const size_t initial_chunks_capacity = 16;
+
+struct segmented_list segmented_list_create(size_t chunk_capacity, size_t bucket_size) {
+	struct segmented_list list = {
+		.chunks = list_create(initial_chunks_capacity, sizeof *list.chunks),
+		.bucket_size = bucket_size,
+	};
+	if (!list.chunks) {
+		return (struct segmented_list){0};
+	}
+	while (((size_t)1 << list.chunk_shift) < chunk_capacity) {
+		++list.chunk_shift;
+	}
+	return list;
+}
+
+void segmented_list_destroy(struct segmented_list *list) {
+	for (size_t i = 0; i < list_get_count(&list->chunks); ++i) {
+		free(list->chunks[i]);
+	}
+	list_destroy(&list->chunks);
+	*list = (struct segmented_list){0};
+}
+
+void *segmented_list_push_back_uninitialized(struct segmented_list *list) {
+	// Add a chunk if the last one is full.
+	if (list->count == list_get_count(&list->chunks) << list->chunk_shift) {
+		char *chunk = malloc(list->bucket_size << list->chunk_shift);
+		if (!chunk) {
+			return NULL;
+		}
+		if (!list_push_back(&list->chunks, &chunk)) {
+			free(chunk);
+			return NULL;
+		}
+	}
+	++list->count;
+	return segmented_list_get(list, list->count - 1);
+}
+
+void *segmented_list_push_back(struct segmented_list *list, const void *value) {
+	void *new_value = segmented_list_push_back_uninitialized(list);
+	if (!new_value) {
+		return NULL;
+	}
+	memcpy(new_value, value, list->bucket_size);
+	return new_value;
+}
@@ -0,0 +1,34 @@
+#ifndef SEGMENTED_LIST_H
+#define SEGMENTED_LIST_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// A list stored in fixed size chunks that never move, so growing it never copies elements and
+// pointers to elements stay valid. A directory of chunks makes indexing constant time.
+struct segmented_list {
+	char **chunks; // Points to a list.
+	size_t count;
+	size_t bucket_size;
+	size_t chunk_shift; // Each chunk holds `1 << chunk_shift` elements.
+};
+
+// Rounds `chunk_capacity` up to a power of two. Returns a completely zeroed struct if a memory error
+// occurred.
+struct segmented_list segmented_list_create(size_t chunk_capacity, size_t bucket_size);
+
+void segmented_list_destroy(struct segmented_list *list);
+
+// Assumes `index` is less than `list`'s count.
+static inline void *segmented_list_get(struct segmented_list *list, size_t index) {
+	size_t mask = ((size_t)1 << list->chunk_shift) - 1;
+	return list->chunks[index >> list->chunk_shift] + (index & mask)*list->bucket_size;
+}
+
+// Returns a pointer to the new element if no memory errors occurred, null otherwise.
+void *segmented_list_push_back_uninitialized(struct segmented_list *list);
+
+// Returns a pointer to the new element if no memory errors occurred, null otherwise.
+void *segmented_list_push_back(struct segmented_list *list, const void *value);
+
+#endif // SEGMENTED_LIST_H
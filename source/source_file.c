@@ -0,0 +1,49 @@
+#include <stddef.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source_file.h"
+
+bool source_file_open(const char *path, struct source_file *file) {
+	*file = (struct source_file){0};
+	int descriptor = open(path, O_RDONLY);
+	if (descriptor == -1) {
+		return false;
+	}
+	struct stat status;
+	if (fstat(descriptor, &status) == -1) {
+		goto error;
+	}
+	// `mmap()` can't map an empty file.
+	if (status.st_size == 0) {
+		close(descriptor);
+		file->text = "";
+		return true;
+	}
+
+	void *text = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	if (text == MAP_FAILED) {
+		goto error;
+	}
+	// The lexer reads the file front to back once.
+	madvise(text, status.st_size, MADV_SEQUENTIAL);
+	close(descriptor);
+	*file = (struct source_file){
+		.text = text,
+		.text_length = status.st_size,
+	};
+	return true;
+
+error:
+	close(descriptor);
+	return false;
+}
+
+void source_file_close(struct source_file *file) {
+	if (file->text_length) {
+		munmap((void*)file->text, file->text_length);
+	}
+	*file = (struct source_file){0};
+}
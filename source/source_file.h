@@ -0,0 +1,19 @@
+#ifndef SOURCE_FILE_H
+#define SOURCE_FILE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// A source file mapped read only into memory. `text` isn't null terminated.
+struct source_file {
+	const char *text;
+	size_t text_length;
+};
+
+// Maps the file at `path` into memory without copying it. Returns true if successful, returns false
+// and leaves `file` zeroed otherwise.
+bool source_file_open(const char *path, struct source_file *file);
+
+void source_file_close(struct source_file *file);
+
+#endif // SOURCE_FILE_H
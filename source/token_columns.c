@@ -0,0 +1,267 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "token_columns.h"
+#include "lexer.h"
+#include "list.h"
+
+LIST_DEFINE(uint8_list, uint8_t)
+LIST_DEFINE(uint16_list, uint16_t)
+LIST_DEFINE(uint32_list, uint32_t)
+
+static const size_t initial_long_lengths_capacity = 16;
+
+static const size_t initial_values_capacity = 64;
+
+static bool is_literal(uint8_t type) {
+	return type == TOKEN_TYPE_NUMBER || type == TOKEN_TYPE_CHARACTER || type == TOKEN_TYPE_STRING;
+}
+
+// Returns true if tokens of `type` have an entry in `values`.
+static bool has_value(uint8_t type) {
+	return is_literal(type) || type == TOKEN_TYPE_IDENTIFIER;
+}
+
+// Binary searches a list sorted by token index for `index`'s entry. The entries must start with a
+// 32 bit token index, like `struct token_long_length` and `struct token_value`.
+static void *find_entry(void **list, size_t index) {
+	size_t bucket_size = list_get_bucket_size(list);
+	size_t low = 0;
+	size_t high = list_get_count(list);
+	while (low < high) {
+		size_t middle = low + (high - low)/2;
+		if (*(uint32_t*)((char*)*list + middle*bucket_size) < index) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return (char*)*list + low*bucket_size;
+}
+
+// Replaces the entries of a list sorted by token index that belong to the `count` tokens starting at
+// `index` with the entries of `replacement`, which belong to `replacement_count` tokens. Both lists'
+// entries must start with a 32 bit token index. Returns true if no memory errors occurred.
+static bool replace_entries(void **list, void **replacement, size_t index, size_t count, size_t replacement_count) {
+	size_t bucket_size = list_get_bucket_size(list);
+	size_t start = ((char*)find_entry(list, index) - (char*)*list)/bucket_size;
+	size_t end = ((char*)find_entry(list, index + count) - (char*)*list)/bucket_size;
+	size_t replacement_entries_count = list_get_count(replacement);
+	if (!list_replace_range(list, start, end - start, *replacement, replacement_entries_count)) {
+		return false;
+	}
+	for (size_t i = start; i < start + replacement_entries_count; ++i) {
+		*(uint32_t*)((char*)*list + i*bucket_size) += index;
+	}
+	size_t entries_count = list_get_count(list);
+	for (size_t i = start + replacement_entries_count; i < entries_count; ++i) {
+		*(uint32_t*)((char*)*list + i*bucket_size) += replacement_count - count;
+	}
+	return true;
+}
+
+struct token_columns token_columns_create(size_t capacity) {
+	struct token_columns tokens = {
+		.types = list_create(capacity, sizeof *tokens.types),
+	};
+	if (!tokens.types) {
+		goto error1;
+	}
+	tokens.text_indices = list_create(capacity, sizeof *tokens.text_indices);
+	if (!tokens.text_indices) {
+		goto error2;
+	}
+	tokens.text_lengths = list_create(capacity, sizeof *tokens.text_lengths);
+	if (!tokens.text_lengths) {
+		goto error3;
+	}
+	tokens.long_lengths = list_create(initial_long_lengths_capacity, sizeof *tokens.long_lengths);
+	if (!tokens.long_lengths) {
+		goto error4;
+	}
+	tokens.values = list_create(initial_values_capacity, sizeof *tokens.values);
+	if (!tokens.values) {
+		goto error5;
+	}
+	return tokens;
+
+error5:
+	list_destroy(&tokens.long_lengths);
+error4:
+	list_destroy(&tokens.text_lengths);
+error3:
+	list_destroy(&tokens.text_indices);
+error2:
+	list_destroy(&tokens.types);
+error1:
+	return (struct token_columns){0};
+}
+
+void token_columns_destroy(struct token_columns *tokens) {
+	list_destroy(&tokens->types);
+	list_destroy(&tokens->text_indices);
+	list_destroy(&tokens->text_lengths);
+	list_destroy(&tokens->long_lengths);
+	list_destroy(&tokens->values);
+	if (tokens->line_starts) {
+		list_destroy(&tokens->line_starts);
+	}
+	if (tokens->constants.constants) {
+		constant_pool_destroy(&tokens->constants);
+	}
+	*tokens = (struct token_columns){0};
+}
+
+size_t token_columns_get_count(struct token_columns *tokens) {
+	return list_get_count(&tokens->types);
+}
+
+struct token token_columns_get(struct token_columns *tokens, size_t index) {
+	struct token token = {
+		.text_index = tokens->text_indices[index],
+		.text_length = tokens->text_lengths[index],
+		.type = tokens->types[index],
+	};
+	if (token.text_length == TOKEN_LONG_LENGTH) {
+		token.text_length = ((struct token_long_length*)find_entry((void**)&tokens->long_lengths, index))->text_length;
+	}
+	if (has_value(token.type)) {
+		uint32_t value = ((struct token_value*)find_entry((void**)&tokens->values, index))->value;
+		if (token.type == TOKEN_TYPE_IDENTIFIER) {
+			token.atom = value;
+		} else {
+			token.constant_index = value;
+		}
+	}
+	return token;
+}
+
+bool token_columns_push_back(struct token_columns *tokens, struct token *token) {
+	if (token->text_index + token->text_length > UINT32_MAX) {
+		return false;
+	}
+	size_t index = list_get_count(&tokens->types);
+	bool is_long = token->text_length >= TOKEN_LONG_LENGTH;
+	// Reserve room in every list first, so a memory error can't leave them out of step.
+	if (
+		!uint8_list_reserve(&tokens->types, 1)
+		|| !uint32_list_reserve(&tokens->text_indices, 1)
+		|| !uint16_list_reserve(&tokens->text_lengths, 1)
+		|| (is_long && !list_reserve(&tokens->long_lengths, 1))
+		|| (has_value(token->type) && !list_reserve(&tokens->values, 1))
+	) {
+		return false;
+	}
+	if (is_long) {
+		struct token_long_length long_length = {
+			.token_index = index,
+			.text_length = token->text_length,
+		};
+		list_push_back(&tokens->long_lengths, &long_length);
+	}
+	if (has_value(token->type)) {
+		struct token_value value = {
+			.token_index = index,
+			.value = token->type == TOKEN_TYPE_IDENTIFIER ? token->atom : token->constant_index,
+		};
+		list_push_back(&tokens->values, &value);
+	}
+	uint8_list_push_back(&tokens->types, token->type);
+	uint32_list_push_back(&tokens->text_indices, token->text_index);
+	uint16_list_push_back(&tokens->text_lengths, token->text_length < TOKEN_LONG_LENGTH ? token->text_length : TOKEN_LONG_LENGTH);
+	return true;
+}
+
+bool token_columns_reserve(struct token_columns *tokens, size_t count) {
+	return list_reserve(&tokens->types, count) && list_reserve(&tokens->text_indices, count) && list_reserve(&tokens->text_lengths, count);
+}
+
+void token_columns_shrink_to_fit(struct token_columns *tokens) {
+	// Shrinking can't lose any tokens, so the columns stay usable even if it fails.
+	list_shrink_to_fit(&tokens->types);
+	list_shrink_to_fit(&tokens->text_indices);
+	list_shrink_to_fit(&tokens->text_lengths);
+}
+
+bool token_columns_append(struct token_columns *destination, struct token_columns *source) {
+	size_t count = list_get_count(&destination->types);
+	size_t source_count = list_get_count(&source->types);
+	size_t long_lengths_count = list_get_count(&destination->long_lengths);
+	size_t values_count = list_get_count(&destination->values);
+	if (
+		!list_reserve(&destination->types, source_count)
+		|| !list_reserve(&destination->text_indices, source_count)
+		|| !list_reserve(&destination->text_lengths, source_count)
+		|| !list_reserve(&destination->long_lengths, list_get_count(&source->long_lengths))
+		|| !list_reserve(&destination->values, list_get_count(&source->values))
+	) {
+		return false;
+	}
+	if (destination->line_starts && source->line_starts) {
+		if (!list_reserve(&destination->line_starts, list_get_count(&source->line_starts))) {
+			return false;
+		}
+		list_append_n(&destination->line_starts, source->line_starts, list_get_count(&source->line_starts));
+	}
+	list_append_n(&destination->types, source->types, source_count);
+	list_append_n(&destination->text_indices, source->text_indices, source_count);
+	list_append_n(&destination->text_lengths, source->text_lengths, source_count);
+	list_append_n(&destination->long_lengths, source->long_lengths, list_get_count(&source->long_lengths));
+	list_append_n(&destination->values, source->values, list_get_count(&source->values));
+	for (size_t i = long_lengths_count; i < list_get_count(&destination->long_lengths); ++i) {
+		destination->long_lengths[i].token_index += count;
+	}
+	// Adding the constants in token order gives them the indices lexing the whole text would. Atoms come
+	// from the global interner, so they mean the same thing in both.
+	bool has_constants = destination->constants.constants && source->constants.constants;
+	size_t new_values_count = list_get_count(&destination->values);
+	for (size_t i = values_count; i < new_values_count; ++i) {
+		struct token_value *value = destination->values + i;
+		value->token_index += count;
+		if (has_constants && is_literal(destination->types[value->token_index]) && !constant_pool_add_copy(&destination->constants, &source->constants, value->value, &value->value)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool token_columns_replace(struct token_columns *tokens, size_t index, size_t count, struct token_columns *replacement, ptrdiff_t text_index_delta) {
+	size_t replacement_count = list_get_count(&replacement->types);
+	// Reserve room first, so the token columns can't fail halfway through.
+	if (
+		replacement_count > count && (
+			!list_reserve(&tokens->types, replacement_count - count)
+			|| !list_reserve(&tokens->text_indices, replacement_count - count)
+			|| !list_reserve(&tokens->text_lengths, replacement_count - count)
+		)
+	) {
+		return false;
+	}
+	list_replace_range(&tokens->types, index, count, replacement->types, replacement_count);
+	list_replace_range(&tokens->text_indices, index, count, replacement->text_indices, replacement_count);
+	list_replace_range(&tokens->text_lengths, index, count, replacement->text_lengths, replacement_count);
+	size_t tokens_count = list_get_count(&tokens->text_indices);
+	for (size_t i = index + replacement_count; i < tokens_count; ++i) {
+		tokens->text_indices[i] += text_index_delta;
+	}
+	return replace_entries((void**)&tokens->long_lengths, (void**)&replacement->long_lengths, index, count, replacement_count) && replace_entries((void**)&tokens->values, (void**)&replacement->values, index, count, replacement_count);
+}
+
+struct text_position token_columns_find_position(struct token_columns *tokens, size_t text_index) {
+	// Find the number of lines that start at or before `text_index`, not counting the first one.
+	size_t low = 0;
+	size_t high = list_get_count(&tokens->line_starts);
+	while (low < high) {
+		size_t middle = low + (high - low)/2;
+		if (tokens->line_starts[middle] <= text_index) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	size_t line_start = low == 0 ? 0 : tokens->line_starts[low - 1];
+	return (struct text_position){
+		.line = low + 1,
+		.column = text_index - line_start + 1,
+	};
+}
@@ -0,0 +1,80 @@
+#ifndef TOKEN_COLUMNS_H
+#define TOKEN_COLUMNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "lexer.h"
+
+// Token lengths of at least this are stored in `long_lengths`.
+#define TOKEN_LONG_LENGTH UINT16_MAX
+
+// The length of a token too long for `text_lengths`.
+struct token_long_length {
+	uint32_t token_index;
+	uint32_t text_length;
+};
+
+// The constant index of a literal token, or the atom of an identifier.
+struct token_value {
+	uint32_t token_index;
+	uint32_t value;
+};
+
+// A token list stored as one array per field: 7 bytes per token, plus 8 more for each literal,
+// identifier, and token of 64 KiB or longer, which also have an entry in a side list. Code that only
+// needs token types, like the parser, only touches `types`. Text indices are 32 bits, so the text can
+// be at most 4 GiB.
+struct token_columns {
+	uint8_t *types; // Points to a list.
+	uint32_t *text_indices; // Points to a list.
+	uint16_t *text_lengths; // Points to a list.
+	struct token_long_length *long_lengths; // Points to a list sorted by token index.
+	struct token_value *values; // Points to a list sorted by token index, one per literal and identifier.
+	uint32_t *line_starts; // Points to a list, or null. The text index after each newline, from the lexer.
+	struct constant_pool constants; // Zeroed unless the tokens came from the lexer.
+};
+
+// A line and column in the text, both starting at 1. Columns count bytes.
+struct text_position {
+	size_t line;
+	size_t column;
+};
+
+// Returns a completely zeroed struct if a memory error occurred.
+struct token_columns token_columns_create(size_t capacity);
+
+void token_columns_destroy(struct token_columns *tokens);
+
+size_t token_columns_get_count(struct token_columns *tokens);
+
+// Assumes `index` is less than `tokens`'s count. Takes constant time unless the token has side list
+// entries, which are found with a binary search, taking O(log n) time. Code that walks the tokens in
+// order and needs atoms or constants can walk `values` alongside them instead.
+struct token token_columns_get(struct token_columns *tokens, size_t index);
+
+// Returns true if no memory errors occurred and the token's text index fits in 32 bits.
+bool token_columns_push_back(struct token_columns *tokens, struct token *token);
+
+// Makes sure `tokens` has room for `count` more tokens. Returns true if no memory errors occurred.
+bool token_columns_reserve(struct token_columns *tokens, size_t count);
+
+// Frees the columns' unused capacity, such as after lexing into columns sized from an estimate.
+void token_columns_shrink_to_fit(struct token_columns *tokens);
+
+// Appends all of `source`'s tokens and line starts to `destination`, which must come right before
+// `source` in the text. If both have constant pools, `source`'s literals are added to
+// `destination`'s pool. Returns true if no memory errors occurred.
+bool token_columns_append(struct token_columns *destination, struct token_columns *source);
+
+// Replaces the `count` tokens starting at `index` with `replacement`'s tokens and adds
+// `text_index_delta` to the text indices of the tokens after them. `replacement`'s constant indices
+// must refer to `tokens`'s constant pool. Line starts aren't changed. Returns true if no memory errors
+// occurred.
+bool token_columns_replace(struct token_columns *tokens, size_t index, size_t count, struct token_columns *replacement, ptrdiff_t text_index_delta);
+
+// Finds the line and column of `text_index` with a binary search over `tokens`'s line starts.
+// Assumes `tokens` has line starts.
+struct text_position token_columns_find_position(struct token_columns *tokens, size_t text_index);
+
+#endif // TOKEN_COLUMNS_H
@@ -1,30 +1,47 @@
 #include <stdio.h>
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
-#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
 #include "visitor.h"
 #include "lexer.h"
+#include "token_columns.h"
+#include "interner.h"
 #include "parser.h"
 #include "list.h"
 #include "map.h"
+#include "arena.h"
+#include "hash.h"
+
+// Frozen tables have one CHD bucket, and so one displacement, for about this many keys.
+static const size_t keys_per_frozen_bucket = 4;
+
+// A bucket that no displacement tried so far fits is given up on after this many, and the whole table
+// is made again with the next seed.
+static const uint64_t max_displacement_tries = 1 << 20;
+
+static const uint64_t max_freeze_attempts = 64;
+
+static const size_t initial_namespace_name_capacity = 64;
 
 const char *const compiler_error_messages[] = {
 	[COMPILER_ERROR_TYPE_MULTIPLE_NAMESPACE_DEFINITIONS] = "Can't declare multiple namespaces in one file.",
 };
 
-struct symbol_table symbol_table_create(size_t buckets_capacity, size_t keys_capacity) {
+struct symbol_table symbol_table_create(struct arena *arena, size_t buckets_capacity, size_t keys_capacity) {
 	struct symbol_table table = {
-		.handles = map_create(buckets_capacity, sizeof *table.handles, keys_capacity),
+		.handles = map_create_in_arena(arena, buckets_capacity, sizeof *table.handles, keys_capacity),
 	};
 	if (!table.handles) {
 		goto error1;
 	}
-	table.namespaces = map_create(buckets_capacity, sizeof *table.namespaces, keys_capacity);
+	table.namespaces = map_create_in_arena(arena, buckets_capacity, sizeof *table.namespaces, keys_capacity);
 	if (!table.namespaces) {
 		goto error2;
 	}
-	table.variables = map_create(buckets_capacity, sizeof *table.variables, keys_capacity);
+	table.variables = map_create_in_arena(arena, buckets_capacity, sizeof *table.variables, keys_capacity);
 	if (!table.variables) {
 		goto error3;
 	}
@@ -45,18 +62,337 @@ void symbol_table_destroy(struct symbol_table *table) {
 	*table = (struct symbol_table){0};
 }
 
-struct object object_create(size_t buckets_capacity, size_t keys_capacity) {
+// A key of a table being frozen.
+struct frozen_key {
+	const char *bytes;
+	size_t length;
+	struct symbol_handle *handle;
+	uint64_t hash;
+	uint32_t bucket;
+};
+
+// A key's hash reduced to the two values its position is made from.
+struct frozen_key_hash {
+	uint32_t f1;
+	uint32_t f2;
+};
+
+static uint32_t get_frozen_bucket(uint64_t key_hash, uint32_t displacements_count) {
+	return ((key_hash >> 32)*displacements_count) >> 32;
+}
+
+static struct frozen_key_hash get_frozen_key_hash(uint64_t key_hash, uint32_t count) {
+	return (struct frozen_key_hash){
+		.f1 = ((key_hash & UINT32_MAX)*count) >> 32,
+		.f2 = (((key_hash*0x9E3779B97F4A7C15u) >> 32)*count) >> 32,
+	};
+}
+
+static uint32_t get_frozen_position(struct frozen_key_hash key_hash, struct frozen_displacement displacement, uint32_t count) {
+	return (key_hash.f2 + (uint64_t)key_hash.f1*displacement.first + displacement.second) % count;
+}
+
+static bool is_frozen_position_occupied(const uint64_t *occupied, uint32_t position) {
+	return occupied[position/64] >> position%64 & 1;
+}
+
+static void occupy_frozen_position(uint64_t *occupied, uint32_t position) {
+	occupied[position/64] |= (uint64_t)1 << position%64;
+}
+
+// Returns the first free position at or after `position`, wrapping around to 0. Some position must be
+// free. Skips whole words of occupied positions, since most are occupied by the time small buckets
+// are placed.
+static uint32_t find_free_frozen_position(const uint64_t *occupied, uint32_t count, uint32_t position) {
+	uint32_t word = position/64;
+	uint64_t free_bits = ~occupied[word] & UINT64_MAX << position%64;
+	while (!free_bits) {
+		word = word == count/64 ? 0 : word + 1;
+		free_bits = ~occupied[word];
+	}
+	return word*64 + __builtin_ctzll(free_bits);
+}
+
+// Finds a displacement for each bucket, largest buckets first, that sends its keys to positions no
+// other key has. `order` gets the keys' indices grouped by bucket, and `positions` gets the position of
+// each of them. `key_hashes` has room for one per key, and `occupied` for a bit per position. Returns
+// false if some bucket didn't fit.
+static bool place_frozen_keys(struct frozen_key *keys, uint32_t count, struct frozen_displacement *displacements, uint32_t displacements_count, uint32_t *bucket_starts, uint32_t *order, uint32_t *positions, struct frozen_key_hash *key_hashes, uint64_t *occupied) {
+	// Group the keys by bucket, with their reduced hashes next to each other so trying a displacement
+	// reads no other memory.
+	memset(bucket_starts, 0, (displacements_count + 1)*sizeof *bucket_starts);
+	for (uint32_t i = 0; i < count; ++i) {
+		++bucket_starts[keys[i].bucket + 1];
+	}
+	uint32_t max_bucket_size = 0;
+	for (uint32_t i = 0; i < displacements_count; ++i) {
+		if (bucket_starts[i + 1] > max_bucket_size) {
+			max_bucket_size = bucket_starts[i + 1];
+		}
+		bucket_starts[i + 1] += bucket_starts[i];
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t j = bucket_starts[keys[i].bucket]++;
+		order[j] = i;
+		key_hashes[j] = get_frozen_key_hash(keys[i].hash, count);
+	}
+	for (uint32_t i = displacements_count; i > 0; --i) {
+		bucket_starts[i] = bucket_starts[i - 1];
+	}
+	bucket_starts[0] = 0;
+
+	// The bits past the last position are set, so they're never found free.
+	memset(occupied, 0, (count/64 + 1)*sizeof *occupied);
+	occupied[count/64] = UINT64_MAX << count%64;
+	memset(displacements, 0, displacements_count*sizeof *displacements);
+	for (uint32_t size = max_bucket_size; size > 0; --size) {
+		for (uint32_t bucket = 0; bucket < displacements_count; ++bucket) {
+			uint32_t start = bucket_starts[bucket];
+			if (bucket_starts[bucket + 1] - start != size) {
+				continue;
+			}
+			// Each displacement tried sends the bucket's first key to a free position, going on from where its
+			// hash points, so only the other keys can collide. A blind try would only fit with probability
+			// (free fraction)^size, and the last buckets are placed with few positions free. Buckets of one key
+			// always fit the first try.
+			uint32_t hashed_position = get_frozen_position(key_hashes[start], (struct frozen_displacement){0}, count);
+			uint32_t first_free = find_free_frozen_position(occupied, count, hashed_position);
+			bool placed = false;
+			uint64_t tries = 0;
+			for (uint32_t first = 0; first < count && tries < max_displacement_tries && !placed; ++first) {
+				struct frozen_displacement displacement = {first, 0};
+				uint32_t position = get_frozen_position(key_hashes[start], displacement, count);
+				// Once every free position has been tried with this `first`, the next one is tried.
+				uint32_t free_candidate = first_free;
+				do {
+					displacement.second = (free_candidate + count - position)%count;
+					positions[start] = free_candidate;
+					placed = true;
+					for (uint32_t i = start + 1; i < start + size && placed; ++i) {
+						positions[i] = get_frozen_position(key_hashes[i], displacement, count);
+						placed = !is_frozen_position_occupied(occupied, positions[i]);
+						// Keys of the same bucket can't share a position either.
+						for (uint32_t j = start; j < i && placed; ++j) {
+							placed = positions[j] != positions[i];
+						}
+					}
+					displacements[bucket] = displacement;
+					free_candidate = find_free_frozen_position(occupied, count, free_candidate + 1 == count ? 0 : free_candidate + 1);
+				} while (!placed && free_candidate != first_free && ++tries < max_displacement_tries);
+			}
+			if (!placed) {
+				return false;
+			}
+			for (uint32_t i = start; i < start + size; ++i) {
+				occupy_frozen_position(occupied, positions[i]);
+			}
+		}
+	}
+	return true;
+}
+
+// Points `table`'s arrays into its block, after the header.
+static void lay_out_frozen_symbol_table(struct frozen_symbol_table *table) {
+	table->header = (struct frozen_symbol_table_header*)table->block;
+	table->slots = (struct frozen_symbol_slot*)(table->header + 1);
+	table->displacements = (struct frozen_displacement*)(table->slots + table->header->count);
+	table->keys = (char*)(table->displacements + table->header->displacements_count);
+}
+
+static size_t get_frozen_symbol_table_block_size(size_t count, size_t displacements_count, size_t keys_size) {
+	return sizeof(struct frozen_symbol_table_header) + count*sizeof(struct frozen_symbol_slot) + displacements_count*sizeof(struct frozen_displacement) + keys_size;
+}
+
+struct frozen_symbol_table symbol_table_freeze(struct arena *arena, struct symbol_table *table) {
+	size_t count = map_get_buckets_count(&table->handles);
+	size_t displacements_count = (count + keys_per_frozen_bucket - 1)/keys_per_frozen_bucket;
+	if (displacements_count == 0) {
+		displacements_count = 1;
+	}
+	struct interner *interner = interner_get_global();
+	if (!interner) {
+		goto error1;
+	}
+	struct frozen_key *keys = malloc((count + 1)*sizeof *keys);
+	if (!keys) {
+		goto error1;
+	}
+	size_t keys_size = 0;
+	size_t i = 0;
+	for (struct symbol_handle *handle = map_get_next(&table->handles, NULL); handle; handle = map_get_next(&table->handles, handle)) {
+		if (handle->index > UINT32_MAX) {
+			goto error2;
+		}
+		uint32_t atom;
+		memcpy(&atom, map_get_key(&table->handles, handle), sizeof atom);
+		struct interned_name name = interner_get_name(interner, atom);
+		keys[i] = (struct frozen_key){
+			.bytes = name.bytes,
+			.length = name.length,
+			.handle = handle,
+		};
+		keys_size += keys[i++].length;
+	}
+	if (count > UINT32_MAX || keys_size > UINT32_MAX) {
+		goto error2;
+	}
+
+	struct frozen_symbol_table frozen = {
+		.arena = arena,
+		.block_size = get_frozen_symbol_table_block_size(count, displacements_count, keys_size),
+	};
+	frozen.block = arena ? arena_allocate(arena, frozen.block_size) : malloc(frozen.block_size);
+	if (!frozen.block) {
+		goto error2;
+	}
+	*(struct frozen_symbol_table_header*)frozen.block = (struct frozen_symbol_table_header){
+		.count = count,
+		.displacements_count = displacements_count,
+		.keys_size = keys_size,
+	};
+	lay_out_frozen_symbol_table(&frozen);
+
+	uint32_t *bucket_starts = malloc((displacements_count + 1)*sizeof *bucket_starts);
+	if (!bucket_starts) {
+		goto error3;
+	}
+	uint32_t *order = malloc((count + 1)*sizeof *order);
+	if (!order) {
+		goto error4;
+	}
+	uint32_t *positions = malloc((count + 1)*sizeof *positions);
+	if (!positions) {
+		goto error5;
+	}
+	struct frozen_key_hash *key_hashes = malloc((count + 1)*sizeof *key_hashes);
+	if (!key_hashes) {
+		goto error6;
+	}
+	uint64_t *occupied = malloc((count/64 + 1)*sizeof *occupied);
+	if (!occupied) {
+		goto error7;
+	}
+	// Seeds are tried in order rather than picked at random, so freezing the same symbols always makes
+	// the same bytes.
+	bool placed = false;
+	for (; frozen.header->seed < max_freeze_attempts; ++frozen.header->seed) {
+		for (i = 0; i < count; ++i) {
+			keys[i].hash = hash_string_seeded(keys[i].bytes, keys[i].length, frozen.header->seed);
+			keys[i].bucket = get_frozen_bucket(keys[i].hash, displacements_count);
+		}
+		placed = place_frozen_keys(keys, count, frozen.displacements, displacements_count, bucket_starts, order, positions, key_hashes, occupied);
+		if (placed) {
+			break;
+		}
+	}
+	if (!placed) {
+		goto error8;
+	}
+
+	// The keys' bytes go in the order the keys were grouped in, which only depends on the symbols.
+	uint32_t key_start = 0;
+	for (i = 0; i < count; ++i) {
+		struct frozen_key *key = keys + order[i];
+		frozen.slots[positions[i]] = (struct frozen_symbol_slot){
+			.key_start = key_start,
+			.key_length = key->length,
+			.handle = {
+				.index = key->handle->index,
+				.type = key->handle->type,
+			},
+		};
+		memcpy(frozen.keys + key_start, key->bytes, key->length);
+		key_start += key->length;
+	}
+	free(occupied);
+	free(key_hashes);
+	free(positions);
+	free(order);
+	free(bucket_starts);
+	free(keys);
+	return frozen;
+
+error8:
+	free(occupied);
+error7:
+	free(key_hashes);
+error6:
+	free(positions);
+error5:
+	free(order);
+error4:
+	free(bucket_starts);
+error3:
+	if (arena) {
+		arena_free(arena, frozen.block, frozen.block_size);
+	} else {
+		free(frozen.block);
+	}
+error2:
+	free(keys);
+error1:
+	return (struct frozen_symbol_table){0};
+}
+
+struct frozen_symbol_table frozen_symbol_table_open(struct arena *arena, char *block, size_t block_size) {
+	struct frozen_symbol_table table = {
+		.arena = arena,
+		.block = block,
+		.block_size = block_size,
+	};
+	if (!block || (uintptr_t)block%sizeof(uint64_t) != 0 || block_size < sizeof *table.header) {
+		goto error1;
+	}
+	struct frozen_symbol_table_header *header = (struct frozen_symbol_table_header*)block;
+	if (header->displacements_count == 0 || header->reserved != 0 || block_size != get_frozen_symbol_table_block_size(header->count, header->displacements_count, header->keys_size)) {
+		goto error1;
+	}
+	lay_out_frozen_symbol_table(&table);
+	for (uint32_t i = 0; i < header->count; ++i) {
+		struct frozen_symbol_slot *slot = table.slots + i;
+		if ((uint64_t)slot->key_start + slot->key_length > header->keys_size || slot->handle.type >= SYMBOL_TYPE_COUNT) {
+			goto error1;
+		}
+	}
+	return table;
+
+error1:
+	return (struct frozen_symbol_table){0};
+}
+
+void frozen_symbol_table_destroy(struct frozen_symbol_table *table) {
+	if (!table->arena) {
+		free(table->block);
+	}
+	*table = (struct frozen_symbol_table){0};
+}
+
+struct frozen_symbol_handle *frozen_symbol_table_get(struct frozen_symbol_table *table, const char *name, size_t length) {
+	if (!table->header || table->header->count == 0) {
+		return NULL;
+	}
+	uint32_t count = table->header->count;
+	uint64_t key_hash = hash_string_seeded(name, length, table->header->seed);
+	struct frozen_displacement displacement = table->displacements[get_frozen_bucket(key_hash, table->header->displacements_count)];
+	struct frozen_symbol_slot *slot = table->slots + get_frozen_position(get_frozen_key_hash(key_hash, count), displacement, count);
+	if (slot->key_length != length || memcmp(table->keys + slot->key_start, name, length) != 0) {
+		return NULL;
+	}
+	return &slot->handle;
+}
+
+struct object object_create(struct arena *arena, size_t buckets_capacity, size_t keys_capacity) {
 	struct object object = {
-		.public_symbols = symbol_table_create(buckets_capacity, keys_capacity),
+		.public_symbols = symbol_table_create(arena, buckets_capacity, keys_capacity),
 	};
 	if (!object.public_symbols.handles) {
 		goto error1;
 	}
-	object.private_symbols = symbol_table_create(buckets_capacity, keys_capacity);
+	object.private_symbols = symbol_table_create(arena, buckets_capacity, keys_capacity);
 	if (!object.private_symbols.handles) {
 		goto error2;
 	}
-	object.scopes = symbol_table_create(buckets_capacity, keys_capacity);
+	object.scopes = symbol_table_create(arena, buckets_capacity, keys_capacity);
 	if (!object.scopes.handles) {
 		goto error3;
 	}
@@ -77,60 +413,101 @@ void object_destroy(struct object *object) {
 	*object = (struct object){0};
 }
 
-bool initialize_symbols(char *text, struct token *tokens, struct node *nodes, struct object *object, struct compiler_error **errors) {
-	static char namespace_name[5*1024];
-	struct node *current_node = nodes;
+// Moves to the node at `index`, keeping track of its index in `node_index`.
+static struct node *visitor_move(struct segmented_list *nodes, size_t *node_index, size_t index) {
+	*node_index = index;
+	return segmented_list_get(nodes, index);
+}
+
+bool initialize_symbols(const char *text, struct token_columns *tokens, struct segmented_list *nodes, struct object *object, struct compiler_error **errors) {
+	// Symbols are keyed by the atoms of their names, so looking one up hashes and compares 4 bytes.
+	uint32_t namespace_atom = INTERNER_NO_ATOM;
+	size_t node_index = 0;
+	struct node *current_node = visitor_move(nodes, &node_index, 0);
+	// An empty or comments-only text has no statements to define anything.
+	if (current_node->child_index == NODE_NONE) {
+		return true;
+	}
 	// Traverse to the program's statements.
-	current_node = nodes + current_node->child_index; // current_node = first child of program node
+	current_node = visitor_move(nodes, &node_index, current_node->child_index); // current_node = first child of program node
 	while (true) {
-		if (current_node->type == NODE_TYPE_DEFINITION) {
-			current_node = nodes + current_node->child_index; // current_node = first child of definition
+		// A blank line is a definition with no children, which defines nothing.
+		if (current_node->type == NODE_TYPE_DEFINITION && current_node->child_index != NODE_NONE) {
+			current_node = visitor_move(nodes, &node_index, current_node->child_index); // current_node = first child of definition
 			// Skip the `pub` if needed.
 			if (current_node->type == NODE_TYPE_TOKEN) {
-				current_node = nodes + current_node->next_index; // current node = inner definition
+				current_node = visitor_move(nodes, &node_index, current_node->next_index); // current node = inner definition
 			}
 			continue;
 		}
 
 		if (current_node->type == NODE_TYPE_NAMESPACE_DEFINITION) {
 			// Emit an error if a namespace has already been defined.
-			if (namespace_name[0]) {
+			if (namespace_atom != INTERNER_NO_ATOM) {
 				struct compiler_error error = {
 					.type = COMPILER_ERROR_TYPE_MULTIPLE_NAMESPACE_DEFINITIONS,
-					.node_index = current_node - nodes,
+					.node_index = node_index,
 				};
 				list_push_back(errors, &error);
 				return false;
 			}
 			
-			// Traverse to the namespace name and find the index of its first character.
-			current_node = nodes + current_node->child_index; // current_node = token namespace
-			current_node = nodes + current_node->next_index; // current_node = token identifier
-			struct token *first_token = tokens + current_node->child_index;
-			size_t start_index = first_token->text_index;
-			
-			// Copy the characters of the name to a temporary buffer.
-			// TODO: Check that the name isn't too big.
-			size_t name_index = 0;
-			for (size_t i = start_index; i < list_get_count(&text); ++i) {
-				if (text[i] == '\n') {
+			// Traverse to the namespace name. It runs from its first token to the last one before the
+			// line end, and is made of the tokens' text without the spaces between them, so `ab .c` and
+			// `ab.c` name the same namespace.
+			current_node = visitor_move(nodes, &node_index, current_node->child_index); // current_node = token namespace
+			current_node = visitor_move(nodes, &node_index, current_node->next_index); // current_node = token identifier
+			char *name = list_create(initial_namespace_name_capacity, sizeof *name);
+			if (!name) {
+				return false;
+			}
+			size_t name_tokens_count = 0;
+			while (true) {
+				struct token token = token_columns_get(tokens, current_node->child_index);
+				if (token.type == TOKEN_TYPE_NEWLINE) {
 					break;
 				}
-				if (isspace(text[i])) {
-					continue;
+				if (name_tokens_count == 0) {
+					namespace_atom = token.atom;
+				}
+				if (!list_append_n(&name, text + token.text_index, token.text_length)) {
+					list_destroy(&name);
+					return false;
+				}
+				++name_tokens_count;
+				if (current_node->next_index == NODE_NONE) {
+					break;
+				}
+				current_node = visitor_move(nodes, &node_index, current_node->next_index); // current_node = next token of the name
+			}
+			// A name of one identifier already has an atom from the lexer. Longer ones are interned.
+			struct interner *interner = interner_get_global();
+			bool is_interned = (name_tokens_count == 1 && namespace_atom != INTERNER_NO_ATOM) || (interner && interner_intern(interner, name, list_get_count(&name), &namespace_atom));
+			list_destroy(&name);
+			if (!is_interned) {
+				return false;
+			}
+			if (object) {
+				struct symbol_table *table = &object->public_symbols;
+				struct symbol_handle handle = {
+					.index = map_get_buckets_count(&table->namespaces),
+					.type = SYMBOL_TYPE_NAMESPACE,
+				};
+				struct namespace_symbol symbol;
+				const char *key = (const char*)&namespace_atom;
+				if (!map_add_n(&table->namespaces, key, sizeof namespace_atom, &symbol) || !map_add_n(&table->handles, key, sizeof namespace_atom, &handle)) {
+					return false;
 				}
-				namespace_name[name_index] = text[i];
-				++name_index;
 			}
 
 			// Traverse back up to the definition node.
-			current_node = nodes + current_node->parent_index; // current_node = namespace node
-			current_node = nodes + current_node->parent_index; // current_node = definition node
+			current_node = visitor_move(nodes, &node_index, current_node->parent_index); // current_node = namespace node
+			current_node = visitor_move(nodes, &node_index, current_node->parent_index); // current_node = definition node
 		}
 
 		if (current_node->next_index == NODE_NONE) {
 			return true;
 		}
-		current_node = nodes + current_node->next_index;
+		current_node = visitor_move(nodes, &node_index, current_node->next_index);
 	}
 }
@@ -2,6 +2,7 @@
 #define VISITOR_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include "lexer.h"
 #include "parser.h"
@@ -28,11 +29,57 @@ struct variable_symbol {
 };
 
 struct symbol_table {
-	struct symbol_handle *handles; // Points to a map.
-	struct namespace_symbol *namespaces; // Points to a list.
+	struct symbol_handle *handles; // Points to a map keyed by the atoms of the symbols' names.
+	struct namespace_symbol *namespaces; // Points to a map keyed by atom.
 	struct variable_symbol *variables; // Points to a list.
 };
 
+// A displacement for one CHD bucket. A key in the bucket goes to position
+// `(f2 + f1*first + second) % count`, where `f1` and `f2` come from the key's hash.
+struct frozen_displacement {
+	uint32_t first;
+	uint32_t second;
+};
+
+// A symbol handle with fields of the same size on every platform.
+struct frozen_symbol_handle {
+	uint32_t index;
+	uint32_t type; // An `enum symbol_type`.
+};
+
+// The symbol at one position of a frozen table, with where its name is in the keys.
+struct frozen_symbol_slot {
+	uint32_t key_start;
+	uint32_t key_length;
+	struct frozen_symbol_handle handle;
+};
+
+// The start of a frozen table's block, with everything needed to find the arrays after it.
+struct frozen_symbol_table_header {
+	uint64_t seed;
+	uint32_t count;
+	uint32_t displacements_count;
+	uint32_t keys_size;
+	uint32_t reserved; // Zero.
+};
+
+// An immutable copy of a symbol table's handles, looked up with a minimal perfect hash, so every
+// lookup compares exactly one key. Nothing changes after it's made, so threads can share it without
+// locks. It's keyed by the symbols' names, since atoms depend on the order a process interned names
+// in. The block holds a header, then the slots, displacements and keys, with offsets rather than
+// pointers and only fixed-width fields. Freezing the same symbols always makes the same bytes, so the
+// block can be written to an object file as is and opened again with `frozen_symbol_table_open()` on
+// machines with the same byte order.
+struct frozen_symbol_table {
+	struct arena *arena; // Null if the block is allocated with `malloc()`.
+	char *block;
+	size_t block_size;
+	struct frozen_symbol_table_header *header; // At the start of the block.
+	struct frozen_symbol_slot *slots; // `header->count` of them, one per position.
+	struct frozen_displacement *displacements; // One per bucket of about 4 keys.
+	char *keys; // The names' bytes, back to back.
+};
+
 struct object {
 	struct symbol_table public_symbols; // Points to a map.
 	struct symbol_table private_symbols; // Points to a map.
@@ -52,8 +99,12 @@ struct compiler_error {
 
 extern const char *const compiler_error_messages[];
 
-// Returns a completely zeroed struct if a memory error occurred.
-struct symbol_table symbol_table_create(size_t buckets_capacity, size_t keys_capacity);
+// Defined in "arena.h".
+struct arena;
+
+// Allocates from `arena` unless it's null. Returns a completely zeroed struct if a memory error
+// occurred.
+struct symbol_table symbol_table_create(struct arena *arena, size_t buckets_capacity, size_t keys_capacity);
 
 void symbol_table_destroy(struct symbol_table *table);
 
@@ -69,13 +120,31 @@ bool symbol_table_add_namespace_symbol(struct symbol_table *table, char *name, s
 // Returns true if no memory errors occurred.
 bool symbol_table_add_variable_symbol(struct symbol_table *table, char *name, struct variable_symbol *symbol);
 
-// Returns a completely zeroed struct if a memory error occurred.
-struct object object_create(size_t buckets_capacity, size_t keys_capacity);
+// Copies `table`'s handles into a frozen table, which allocates from `arena` unless it's null. The
+// handles' atoms are replaced by their names from the global interner. Call it once `table` won't
+// change anymore. Returns a completely zeroed struct if a memory error occurred or a handle's index
+// doesn't fit in 32 bits.
+struct frozen_symbol_table symbol_table_freeze(struct arena *arena, struct symbol_table *table);
+
+// Makes a frozen table from a block `symbol_table_freeze()` made, such as one read back from an object
+// file, without copying it. The block must be aligned to 8 bytes, and comes from `arena` unless it's
+// null; the table owns it from then on. Returns a completely zeroed struct, leaving the block alone,
+// if its size or contents don't make a valid table.
+struct frozen_symbol_table frozen_symbol_table_open(struct arena *arena, char *block, size_t block_size);
+
+void frozen_symbol_table_destroy(struct frozen_symbol_table *table);
+
+// Looks up the symbol named by the `length` bytes at `name`. Returns null if no symbol is found.
+struct frozen_symbol_handle *frozen_symbol_table_get(struct frozen_symbol_table *table, const char *name, size_t length);
+
+// Allocates from `arena` unless it's null. Returns a completely zeroed struct if a memory error
+// occurred.
+struct object object_create(struct arena *arena, size_t buckets_capacity, size_t keys_capacity);
 
 void object_destroy(struct object *object);
 
 // Makes a symbol for each definition and makes sure there are no duplicate definitions. Returns
 // true if no memory errors or compiler errors occurred.
-bool initialize_symbols(char *text, struct token *tokens, struct node *nodes, struct object *object, struct compiler_error **errors);
+bool initialize_symbols(const char *text, struct token_columns *tokens, struct segmented_list *nodes, struct object *object, struct compiler_error **errors);
 
 #endif // VISITOR_H
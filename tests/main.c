@@ -1,9 +1,109 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include <pthread.h>
 #include "test.h"
+#include "lexer.h"
+#include "token_columns.h"
+#include "characters.h"
+#include "parser.h"
 #include "visitor.h"
+#include "list.h"
+#include "map.h"
+#include "arena.h"
+#include "segmented_list.h"
+#include "hash.h"
+#include "interner.h"
+#include "concurrent_map.h"
+
+LIST_DEFINE(token_list, struct token)
+
+// Compares two constants, which can come from different pools.
+static bool constants_are_equal(struct constant_pool *a_pool, uint32_t a_index, struct constant_pool *b_pool, uint32_t b_index) {
+	struct constant *a = a_pool->constants + a_index;
+	struct constant *b = b_pool->constants + b_index;
+	if (a->type != b->type) {
+		return false;
+	}
+	if (a->type != TOKEN_TYPE_STRING) {
+		return a->value == b->value;
+	}
+	return a->length == b->length && !memcmp(constant_pool_get_string(a_pool, a), constant_pool_get_string(b_pool, b), a->length);
+}
+
+// Compares two token lists field by field. Literals are compared by value if both lists have
+// constant pools.
+static bool tokens_are_equal(struct token_columns *a, struct token_columns *b) {
+	if (token_columns_get_count(a) != token_columns_get_count(b)) {
+		return false;
+	}
+	bool has_constants = a->constants.constants && b->constants.constants;
+	for (size_t i = 0; i < token_columns_get_count(a); ++i) {
+		struct token a_token = token_columns_get(a, i);
+		struct token b_token = token_columns_get(b, i);
+		if (a_token.text_index != b_token.text_index || a_token.text_length != b_token.text_length || a_token.type != b_token.type || a_token.atom != b_token.atom) {
+			return false;
+		}
+		if (a_token.type > TOKEN_TYPE_STRING) {
+			continue;
+		}
+		if (has_constants ? !constants_are_equal(&a->constants, a_token.constant_index, &b->constants, b_token.constant_index) : a_token.constant_index != b_token.constant_index) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Compares two node lists field by field.
+static bool nodes_are_equal(struct segmented_list *a, struct segmented_list *b) {
+	if (a->count != b->count) {
+		return false;
+	}
+	for (size_t i = 0; i < a->count; ++i) {
+		struct node *a_node = segmented_list_get(a, i);
+		struct node *b_node = segmented_list_get(b, i);
+		if (
+			a_node->type != b_node->type || a_node->parent_index != b_node->parent_index || a_node->child_index != b_node->child_index
+			|| a_node->previous_index != b_node->previous_index || a_node->next_index != b_node->next_index
+		) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Returns true if the compact node `tree_index` has the same shape, types, and tokens as the linked node
+// `node_index`.
+static bool tree_matches_nodes(struct syntax_tree *tree, uint32_t tree_index, struct segmented_list *nodes, size_t node_index) {
+	struct node *node = segmented_list_get(nodes, node_index);
+	if (tree->types[tree_index] != node->type) {
+		return false;
+	}
+	size_t child_index = node->child_index;
+	for (uint32_t i = 0; i < tree->children_counts[tree_index]; ++i) {
+		if (child_index == NODE_NONE) {
+			return false;
+		}
+		struct node *child = segmented_list_get(nodes, child_index);
+		uint32_t reference = tree->children[tree->children_starts[tree_index] + i];
+		if (syntax_tree_is_token(reference)) {
+			if (child->type != NODE_TYPE_TOKEN || child->child_index != syntax_tree_get_token_index(reference)) {
+				return false;
+			}
+		} else if (tree->parents[reference] != tree_index || !tree_matches_nodes(tree, reference, nodes, child_index)) {
+			return false;
+		}
+		child_index = child->next_index;
+	}
+	return child_index == NODE_NONE;
+}
 
 void test_symbol_table_create_and_destroy(void) {
-	struct symbol_table table = symbol_table_create(10, 10);
+	struct symbol_table table = symbol_table_create(NULL, 10, 10);
 	assert(table.handles);
 	if (!table.handles) {
 		return;
@@ -13,7 +113,7 @@ void test_symbol_table_create_and_destroy(void) {
 }
 
 void test_object_create_and_destroy(void) {
-	struct object object = object_create(10, 10);
+	struct object object = object_create(NULL, 10, 10);
 	assert(object.public_symbols.handles);
 	if (!object.public_symbols.handles) {
 		return;
@@ -22,10 +122,921 @@ void test_object_create_and_destroy(void) {
 	assert(!object.public_symbols.handles);
 }
 
+void test_symbol_table_freeze(void) {
+	struct symbol_table table = symbol_table_create(NULL, 16, 1024);
+	assert(table.handles);
+	if (!table.handles) {
+		return;
+	}
+	struct frozen_symbol_table frozen = symbol_table_freeze(NULL, &table);
+	assert(frozen.block && frozen.header->count == 0);
+	assert(!frozen_symbol_table_get(&frozen, "name", 4));
+	frozen_symbol_table_destroy(&frozen);
+
+	// Handles are keyed by atom, like `initialize_symbols()` adds them, and frozen ones by name.
+	char name[32];
+	for (uint32_t i = 0; i < 5000; ++i) {
+		uint32_t atom;
+		assert(interner_intern(interner_get_global(), name, sprintf(name, "frozen_%" PRIu32, i), &atom));
+		struct symbol_handle handle = {.index = i, .type = i%SYMBOL_TYPE_COUNT};
+		assert(map_add_n(&table.handles, (const char*)&atom, sizeof atom, &handle));
+	}
+	frozen = symbol_table_freeze(NULL, &table);
+	assert(frozen.block && frozen.header->count == 5000);
+	for (uint32_t i = 0; i < 5000; ++i) {
+		struct frozen_symbol_handle *handle = frozen_symbol_table_get(&frozen, name, sprintf(name, "frozen_%" PRIu32, i));
+		assert(handle && handle->index == i && handle->type == i%SYMBOL_TYPE_COUNT);
+	}
+	assert(!frozen_symbol_table_get(&frozen, "frozen_5000", 11));
+	assert(!frozen_symbol_table_get(&frozen, "", 0));
+	assert_eq(frozen.block_size, sizeof *frozen.header + 5000*sizeof *frozen.slots + 1250*sizeof *frozen.displacements + frozen.header->keys_size, "%zu", "%zu");
+
+	// Freezing the same symbols again makes the same bytes.
+	struct frozen_symbol_table again = symbol_table_freeze(NULL, &table);
+	assert(again.block_size == frozen.block_size && again.header->seed == frozen.header->seed);
+	assert(again.block && memcmp(again.block, frozen.block, frozen.block_size) == 0);
+	frozen_symbol_table_destroy(&again);
+
+	// A copy of the block, like one read back from an object file, opens as the same table.
+	char *copy = malloc(frozen.block_size);
+	assert(copy);
+	if (copy) {
+		memcpy(copy, frozen.block, frozen.block_size);
+		assert(!frozen_symbol_table_open(NULL, copy, frozen.block_size - 1).block);
+		assert(!frozen_symbol_table_open(NULL, copy, sizeof *frozen.header - 1).block);
+		struct frozen_symbol_table opened = frozen_symbol_table_open(NULL, copy, frozen.block_size);
+		assert(opened.block == copy && opened.header->count == 5000);
+		for (uint32_t i = 0; i < 5000; ++i) {
+			struct frozen_symbol_handle *handle = frozen_symbol_table_get(&opened, name, sprintf(name, "frozen_%" PRIu32, i));
+			assert(handle && handle->index == i && handle->type == i%SYMBOL_TYPE_COUNT);
+		}
+		assert(!frozen_symbol_table_get(&opened, "frozen_5000", 11));
+		// A name that runs past the end of the keys isn't opened.
+		opened.slots[0].key_length = opened.header->keys_size + 1;
+		assert(!frozen_symbol_table_open(NULL, copy, frozen.block_size).block);
+		frozen_symbol_table_destroy(&opened);
+	}
+	frozen_symbol_table_destroy(&frozen);
+	assert(!frozen.block);
+	symbol_table_destroy(&table);
+}
+
+void test_arena_lists_and_maps(void) {
+	struct arena arena = arena_create(1024);
+	assert(arena.block);
+	if (!arena.block) {
+		return;
+	}
+	// The last allocation grows in place until its block is full.
+	int *numbers = list_create_in_arena(&arena, 4, sizeof *numbers);
+	int *first_numbers = numbers;
+	for (int i = 0; i < 1000; ++i) {
+		assert(list_push_back(&numbers, &i));
+		if (i == 100) {
+			assert(numbers == first_numbers);
+		}
+	}
+	for (int i = 0; i < 1000; ++i) {
+		assert_eq(numbers[i], i, "%d", "%d");
+	}
+
+	struct symbol_table table = symbol_table_create(&arena, 2, 16);
+	assert(table.handles);
+	char name[] = "name0";
+	for (size_t i = 0; i < 10; ++i) {
+		name[4] = '0' + i;
+		struct symbol_handle handle = {.index = i};
+		assert(map_add(&table.handles, name, &handle));
+	}
+	for (size_t i = 0; i < 10; ++i) {
+		name[4] = '0' + i;
+		struct symbol_handle *handle = map_get(&table.handles, name);
+		assert(handle && handle->index == i);
+	}
+
+	// Resetting frees everything, so the next allocation starts over in the first block.
+	arena_reset(&arena);
+	int *other_numbers = list_create_in_arena(&arena, 4, sizeof *other_numbers);
+	assert(other_numbers == first_numbers);
+	arena_destroy(&arena);
+	assert(!arena.block);
+}
+
+void test_hash_string(void) {
+	// Known answers for prefixes of `text`, computed by a separate reimplementation of the algorithm.
+	// Lengths 0 to 17 cover every short key path and the first long one, and 32, 33, and 43 cover
+	// whole, partial, and overlapping 16 byte blocks.
+	const char *text = "abcdefghijklmnopqrstuvwxyz_0123456789ABCDEF";
+	static const struct {
+		size_t length;
+		uint64_t zero_seed_hash;
+		uint64_t other_seed_hash;
+	} known_answers[] = {
+		{ 0, 0x0409638ee2bde459ull, 0x2b4e3df129b1f482ull},
+		{ 1, 0x28d2053309d28531ull, 0xaa6a27226ee3d7bfull},
+		{ 2, 0xbc9ce12eaf0083ecull, 0x28cfc2706964470cull},
+		{ 3, 0x02a4f1d7cb516c72ull, 0xc6981f5bd905047dull},
+		{ 4, 0x48dfe2b09ab52113ull, 0x80e8c89af912a468ull},
+		{ 5, 0x35c9e8515eef501eull, 0x509c78bdf52d8095ull},
+		{ 6, 0x875d6d5632069d1aull, 0xdcb629c7585b81afull},
+		{ 7, 0xb2ee217b5e96926cull, 0x6bc4e374557cfbe3ull},
+		{ 8, 0x333d6907eca8bd83ull, 0x0eff11404548b95aull},
+		{ 9, 0x950ec36b41a729d2ull, 0x662ca052e03f5e65ull},
+		{10, 0x2fab8afc554c57dcull, 0x50c38e47b22066f1ull},
+		{11, 0x0385bb829d77290aull, 0xb39226545bce936eull},
+		{12, 0x7ab8f540de52cb18ull, 0x8916b926d3d1665aull},
+		{13, 0xad0ecebacad72760ull, 0x083c744e9317676aull},
+		{14, 0xaba9476961b6c0acull, 0x5232392c4eb53a54ull},
+		{15, 0xe26eff3f7bf37db3ull, 0xd202f67942ee915aull},
+		{16, 0xcfcc03b35e1ecf15ull, 0xfe9ca360b3c5bfabull},
+		{17, 0xbb324a4c7dc9229bull, 0x29e3e7e74e646e29ull},
+		{32, 0x8b515963c6dcd925ull, 0xf6fcb61ae65294cbull},
+		{33, 0x8fc74be8c4866403ull, 0xa4f42cda9f8c82adull},
+		{43, 0x63ddada4118b7013ull, 0x53800b56f032e358ull},
+	};
+	uint64_t other_seed = 0x0123456789abcdefull;
+	for (size_t i = 0; i < sizeof known_answers/sizeof *known_answers; ++i) {
+		size_t length = known_answers[i].length;
+		assert_eq(hash_string_seeded(text, length, 0), known_answers[i].zero_seed_hash, "%" PRIx64, "%" PRIx64);
+		assert_eq(hash_string_seeded(text, length, other_seed), known_answers[i].other_seed_hash, "%" PRIx64, "%" PRIx64);
+		assert_eq(hash_string(text, length), hash_string_seeded(text, length, hash_seed), "%" PRIx64, "%" PRIx64);
+	}
+
+	// Every byte of a key changes its hash and the bytes after it don't, at every length up to past
+	// the 4, 8, and 16 byte word boundaries. Each key starts one byte into the buffer, so reads are
+	// misaligned too.
+	char buffer[48];
+	for (size_t length = 0; length <= 40; ++length) {
+		memcpy(buffer, text, sizeof buffer - 5);
+		memset(buffer + sizeof buffer - 5, 'x', 5);
+		const char *key = buffer + 1;
+		uint64_t hash = hash_string_seeded(key, length, other_seed);
+		assert(hash != hash_string_seeded(key, length, other_seed + 1));
+		if (length > 0) {
+			assert(hash != hash_string_seeded(key, length - 1, other_seed));
+		}
+		for (size_t i = 0; i < length; ++i) {
+			buffer[1 + i] ^= 0x20;
+			assert(hash_string_seeded(key, length, other_seed) != hash);
+			buffer[1 + i] ^= 0x20;
+		}
+		buffer[1 + length] ^= 0x20;
+		assert_eq(hash_string_seeded(key, length, other_seed), hash, "%" PRIx64, "%" PRIx64);
+		buffer[0] ^= 0x20;
+		assert_eq(hash_string_seeded(key, length, other_seed), hash, "%" PRIx64, "%" PRIx64);
+	}
+	assert(hash_string("ab", 2) != hash_string("ba", 2));
+}
+
+struct interner_worker {
+	struct interner *interner;
+	size_t first;
+	bool succeeded;
+};
+
+// Interns 2000 names starting at `first`, checking each atom leads back to its name.
+static void *intern_names(void *argument) {
+	struct interner_worker *worker = argument;
+	worker->succeeded = true;
+	char name[32];
+	for (size_t i = worker->first; i < worker->first + 2000; ++i) {
+		size_t length = sprintf(name, "name%zu", i);
+		uint32_t atom;
+		if (!interner_intern(worker->interner, name, length, &atom) || strcmp(interner_get_name(worker->interner, atom).bytes, name) != 0) {
+			worker->succeeded = false;
+		}
+	}
+	return NULL;
+}
+
+void test_interner(void) {
+	struct interner interner;
+	assert(interner_create(&interner));
+	if (!interner.names) {
+		return;
+	}
+	uint32_t atoms[3];
+	assert(interner_intern(&interner, "alpha", 5, atoms));
+	assert(interner_intern(&interner, "alphabet", 5, atoms + 1));
+	assert(interner_intern(&interner, "beta", 4, atoms + 2));
+	assert(atoms[0] != INTERNER_NO_ATOM && atoms[0] == atoms[1] && atoms[0] != atoms[2]);
+	assert_eq(interner_get_count(&interner), 2, "%zu", "%d");
+	struct interned_name name = interner_get_name(&interner, atoms[2]);
+	assert(name.length == 4 && !strcmp(name.bytes, "beta"));
+	// Names never move, even after the interner grows.
+	char key[32];
+	for (size_t i = 0; i < 10000; ++i) {
+		uint32_t atom;
+		assert(interner_intern(&interner, key, sprintf(key, "name%zu", i), &atom));
+		assert_eq(atom, i + 3, "%" PRIu32, "%zu");
+	}
+	assert(interner_get_name(&interner, atoms[2]).bytes == name.bytes);
+	interner_destroy(&interner);
+
+	// Threads intern overlapping ranges of names, and each name still gets one atom.
+	assert(interner_create(&interner));
+	if (!interner.names) {
+		return;
+	}
+	pthread_t threads[8];
+	struct interner_worker workers[8];
+	for (size_t i = 0; i < 8; ++i) {
+		workers[i] = (struct interner_worker){&interner, i*1000, false};
+		assert(pthread_create(threads + i, NULL, intern_names, workers + i) == 0);
+	}
+	for (size_t i = 0; i < 8; ++i) {
+		pthread_join(threads[i], NULL);
+		assert(workers[i].succeeded);
+	}
+	assert_eq(interner_get_count(&interner), 9000, "%zu", "%d");
+	interner_destroy(&interner);
+
+	// The lexer gives identifiers with the same spelling the same atom from the global interner.
+	struct token_columns tokens = {0};
+	struct lexer_error *errors = NULL;
+	assert(lex("abc namespace abc abd 12", &tokens, &errors));
+	uint32_t token_atoms[5];
+	for (size_t i = 0; i < 5; ++i) {
+		token_atoms[i] = token_columns_get(&tokens, i).atom;
+	}
+	assert(token_atoms[0] != INTERNER_NO_ATOM && token_atoms[0] == token_atoms[2] && token_atoms[0] != token_atoms[3]);
+	assert(token_atoms[1] == INTERNER_NO_ATOM && token_atoms[4] == INTERNER_NO_ATOM);
+	assert(!strcmp(interner_get_name(interner_get_global(), token_atoms[3]).bytes, "abd"));
+	token_columns_destroy(&tokens);
+	list_destroy(&errors);
+}
+
+struct concurrent_map_adder {
+	struct concurrent_map *map;
+	size_t first;
+	bool succeeded;
+};
+
+// Adds 2000 keys starting at `first`, checking each key can be found right after it's added.
+static void *add_concurrent_map_keys(void *argument) {
+	struct concurrent_map_adder *adder = argument;
+	adder->succeeded = true;
+	char key[32];
+	for (size_t i = adder->first; i < adder->first + 2000; ++i) {
+		size_t length = sprintf(key, "key%zu", i);
+		size_t *value = concurrent_map_add(adder->map, key, length, &i);
+		size_t *found = concurrent_map_get(adder->map, key, length);
+		if (!value || *value != i || found != value) {
+			adder->succeeded = false;
+		}
+	}
+	return NULL;
+}
+
+void test_concurrent_map(void) {
+	struct concurrent_map map = concurrent_map_create(5, sizeof(size_t));
+	assert(map.shards);
+	if (!map.shards) {
+		return;
+	}
+	assert_eq(map.shards_count, 8, "%zu", "%d");
+	size_t value = 1;
+	size_t *added = concurrent_map_add(&map, "alpha", 5, &value);
+	assert(added && *added == 1);
+	value = 2;
+	// Adding a key again keeps the first value.
+	assert(concurrent_map_add(&map, "alphabet", 5, &value) == added && *added == 1);
+	assert(concurrent_map_get(&map, "alpha", 5) == added);
+	assert(!concurrent_map_get(&map, "alpha", 4));
+	assert_eq(concurrent_map_get_count(&map), 1, "%zu", "%d");
+	concurrent_map_destroy(&map);
+
+	// Threads add overlapping ranges of keys while the shards grow.
+	map = concurrent_map_create(4, sizeof(size_t));
+	assert(map.shards);
+	if (!map.shards) {
+		return;
+	}
+	pthread_t threads[8];
+	struct concurrent_map_adder adders[8];
+	for (size_t i = 0; i < 8; ++i) {
+		adders[i] = (struct concurrent_map_adder){&map, i*1000, false};
+		assert(pthread_create(threads + i, NULL, add_concurrent_map_keys, adders + i) == 0);
+	}
+	for (size_t i = 0; i < 8; ++i) {
+		pthread_join(threads[i], NULL);
+		assert(adders[i].succeeded);
+	}
+	assert_eq(concurrent_map_get_count(&map), 9000, "%zu", "%d");
+	char key[32];
+	for (size_t i = 0; i < 9000; ++i) {
+		size_t *found = concurrent_map_get(&map, key, sprintf(key, "key%zu", i));
+		assert(found && *found == i);
+	}
+	assert(!concurrent_map_get(&map, "key9000", 7));
+	concurrent_map_destroy(&map);
+}
+
+void test_map_add_get_remove(void) {
+	size_t *map = map_create(0, sizeof *map, 16);
+	assert(map);
+	if (!map) {
+		return;
+	}
+	char key[32];
+	for (size_t i = 0; i < 1000; ++i) {
+		sprintf(key, "key%zu", i);
+		assert(map_add(&map, key, &i));
+	}
+	assert_eq(map_get_buckets_count(&map), 1000, "%zu", "%d");
+	size_t capacity = map_get_buckets_capacity(&map);
+	assert((capacity & (capacity - 1)) == 0 && 1000 <= capacity - capacity/8);
+	for (size_t i = 0; i < 1000; ++i) {
+		sprintf(key, "key%zu", i);
+		size_t *value = map_get(&map, key);
+		assert(value && *value == i);
+		assert(value && !strcmp(map_get_key(&map, value), key));
+	}
+	assert(!map_get(&map, "key1000"));
+	assert(!map_get(&map, ""));
+
+	// Slices of a longer string work as keys without copying them out first.
+	const char *text = "key12 key123 key1234";
+	assert(*(size_t*)map_get_n(&map, text, 5) == 12);
+	assert(*(size_t*)map_get_n(&map, text + 6, 6) == 123);
+	assert(!map_get_n(&map, text + 13, 7));
+	assert(map_add_n(&map, text + 13, 7, &(size_t){1234}));
+	assert(*(size_t*)map_get(&map, "key1234") == 1234);
+	assert(map_remove_n(&map, text + 13, 7));
+
+	// Adding an existing key replaces its value without adding a bucket.
+	size_t value = 5000;
+	assert(map_add(&map, "key5", &value));
+	assert_eq(*(size_t*)map_get(&map, "key5"), 5000, "%zu", "%d");
+	assert_eq(map_get_buckets_count(&map), 1000, "%zu", "%d");
+	value = 5;
+	assert(map_set(&map, "key5", &value));
+	assert(!map_set(&map, "key1000", &value));
+	assert_eq(map_get_buckets_count(&map), 1000, "%zu", "%d");
+
+	// Removed keys leave deleted buckets behind that later lookups probe past.
+	for (size_t i = 0; i < 1000; i += 2) {
+		sprintf(key, "key%zu", i);
+		assert(map_remove(&map, key));
+		assert(!map_remove(&map, key));
+	}
+	assert_eq(map_get_buckets_count(&map), 500, "%zu", "%d");
+	for (size_t i = 0; i < 1000; ++i) {
+		sprintf(key, "key%zu", i);
+		size_t *value = map_get(&map, key);
+		assert(i % 2 ? value && *value == i : !value);
+	}
+
+	// Adding and removing a key at the shrink threshold doesn't rehash every time.
+	while (map_get_buckets_count(&map) > map_get_buckets_capacity(&map)/4 + 1) {
+		sprintf(key, "key%zu", map_get_buckets_count(&map)*2 - 1);
+		assert(map_remove(&map, key));
+	}
+	capacity = map_get_buckets_capacity(&map);
+	for (size_t i = 0; i < 100; ++i) {
+		assert(map_remove(&map, "key1"));
+		assert_eq(map_get_buckets_capacity(&map), capacity/2, "%zu", "%zu");
+		// Rehashing drops the removed keys' bytes.
+		if (i == 0) {
+			assert(map_get_keys_size(&map) <= map_get_buckets_count(&map)*sizeof "key999");
+		}
+		assert(map_add(&map, "key1", &(size_t){1}));
+	}
+	map_destroy(&map);
+
+	// Growing only moves the buckets, so keys stay where they are in the pool.
+	map = map_create(0, sizeof *map, 64*1024);
+	assert(map);
+	if (!map) {
+		return;
+	}
+	assert(map_add(&map, "first", &(size_t){0}));
+	char *first = map_get_key(&map, map_get(&map, "first"));
+	for (size_t i = 0; i < 1000; ++i) {
+		sprintf(key, "key%zu", i);
+		assert(map_add(&map, key, &i));
+	}
+	assert(map_get_buckets_capacity(&map) > 16);
+	assert(map_get_key(&map, map_get(&map, "first")) == first);
+	map_destroy(&map);
+}
+
+void test_list_reserve_append_and_shrink(void) {
+	int *numbers = list_create(0, sizeof *numbers);
+	assert(numbers);
+	if (!numbers) {
+		return;
+	}
+	assert(list_reserve(&numbers, 10));
+	assert(list_get_capacity(&numbers) >= 10);
+	int values[] = {1, 2, 3, 4, 5};
+	assert(list_append_n(&numbers, values, 5));
+	assert(list_append_n(&numbers, values, 5));
+	assert_eq(list_get_count(&numbers), 10, "%zu", "%d");
+	for (size_t i = 0; i < list_get_count(&numbers); ++i) {
+		assert_eq(numbers[i], values[i%5], "%d", "%d");
+	}
+	assert(list_shrink_to_fit(&numbers));
+	assert_eq(list_get_capacity(&numbers), 10, "%zu", "%d");
+
+	// An empty list can still grow after shrinking.
+	list_set_count(&numbers, 0);
+	assert(list_shrink_to_fit(&numbers));
+	assert(list_push_back(&numbers, values));
+	assert_eq(numbers[0], 1, "%d", "%d");
+	list_destroy(&numbers);
+}
+
+void test_typed_list(void) {
+	struct token *tokens = token_list_create(1);
+	assert(tokens);
+	if (!tokens) {
+		return;
+	}
+	for (size_t i = 0; i < 100; ++i) {
+		assert(token_list_push_back(&tokens, (struct token){.text_index = i, .type = TOKEN_TYPE_IDENTIFIER}));
+	}
+	// Typed lists work with the untyped functions too.
+	assert_eq(token_list_get_count(&tokens), 100, "%zu", "%d");
+	assert_eq(list_get_count(&tokens), 100, "%zu", "%d");
+	assert_eq(list_get_bucket_size(&tokens), sizeof(struct token), "%zu", "%zu");
+	assert_eq(token_list_get(&tokens, 42)->text_index, 42, "%zu", "%d");
+	struct token token;
+	assert(token_list_pop_back(&tokens, &token));
+	assert_eq(token.text_index, 99, "%zu", "%d");
+	assert_eq(list_get_count(&tokens), 99, "%zu", "%d");
+	list_destroy(&tokens);
+}
+
+void test_segmented_list_keeps_addresses(void) {
+	struct segmented_list list = segmented_list_create(100, sizeof(size_t));
+	assert(list.chunks);
+	if (!list.chunks) {
+		return;
+	}
+	size_t *first = NULL;
+	for (size_t i = 0; i < 10000; ++i) {
+		size_t *element = segmented_list_push_back(&list, &i);
+		assert(element);
+		if (i == 0) {
+			first = element;
+		}
+	}
+	assert_eq(list.count, 10000, "%zu", "%d");
+	assert(first == segmented_list_get(&list, 0));
+	for (size_t i = 0; i < list.count; ++i) {
+		assert_eq(*(size_t*)segmented_list_get(&list, i), i, "%zu", "%zu");
+	}
+	segmented_list_destroy(&list);
+	assert(!list.chunks);
+}
+
+void test_lookup_keyword(void) {
+	for (size_t i = TOKEN_TYPE_NAMESPACE; i < TOKEN_TYPE_DOT; ++i) {
+		assert_eq(lookup_keyword(token_type_names[i], strlen(token_type_names[i])), i, "%d", "%zu");
+	}
+	assert_eq(lookup_keyword("namespaces", 10), TOKEN_TYPE_IDENTIFIER, "%d", "%d");
+	assert_eq(lookup_keyword("nomespace", 9), TOKEN_TYPE_IDENTIFIER, "%d", "%d");
+	assert_eq(lookup_keyword("i", 1), TOKEN_TYPE_IDENTIFIER, "%d", "%d");
+	assert_eq(lookup_keyword("ifs", 2), TOKEN_TYPE_IF, "%d", "%d");
+}
+
+void test_lex_keywords_and_identifiers(void) {
+	struct token_columns tokens = {0};
+	struct lexer_error *errors = NULL;
+	assert(lex("pub namespace _casex case", &tokens, &errors));
+	assert_eq(token_columns_get_count(&tokens), 4, "%zu", "%d");
+	assert_eq(tokens.types[0], TOKEN_TYPE_PUB, "%d", "%d");
+	assert_eq(tokens.types[1], TOKEN_TYPE_NAMESPACE, "%d", "%d");
+	assert_eq(tokens.types[2], TOKEN_TYPE_IDENTIFIER, "%d", "%d");
+	assert_eq(tokens.types[3], TOKEN_TYPE_CASE, "%d", "%d");
+	token_columns_destroy(&tokens);
+	list_destroy(&errors);
+}
+
+void test_lex_operators_longest_match(void) {
+	struct token_columns tokens = {0};
+	struct lexer_error *errors = NULL;
+	assert(lex("<<= << <= < -> -= - >>= >> >= > == = != x<y ?", &tokens, &errors));
+	enum token_type expected_types[] = {
+		TOKEN_TYPE_LEFT_SHIFT_ASSIGN, TOKEN_TYPE_LEFT_SHIFT, TOKEN_TYPE_LESS_EQUAL, TOKEN_TYPE_LESS,
+		TOKEN_TYPE_ARROW, TOKEN_TYPE_MINUS_ASSIGN, TOKEN_TYPE_MINUS, TOKEN_TYPE_RIGHT_SHIFT_ASSIGN,
+		TOKEN_TYPE_RIGHT_SHIFT, TOKEN_TYPE_GREATER_EQUAL, TOKEN_TYPE_GREATER, TOKEN_TYPE_EQUAL,
+		TOKEN_TYPE_ASSIGN, TOKEN_TYPE_NOT_EQUAL, TOKEN_TYPE_IDENTIFIER, TOKEN_TYPE_LEFT_ANGLE_BRACKET,
+		TOKEN_TYPE_IDENTIFIER,
+	};
+	size_t expected_count = sizeof expected_types/sizeof *expected_types;
+	assert_eq(token_columns_get_count(&tokens), expected_count, "%zu", "%zu");
+	for (size_t i = 0; i < expected_count && i < token_columns_get_count(&tokens); ++i) {
+		assert_eq(tokens.types[i], expected_types[i], "%d", "%d");
+	}
+	assert_eq(list_get_count(&errors), 1, "%zu", "%d");
+	token_columns_destroy(&tokens);
+	list_destroy(&errors);
+}
+
+void test_lex_n_stops_at_length(void) {
+	const char *text = "pub namespace ab // c\n'x' \"y\" <<= zzz";
+	for (size_t length = 0; length <= strlen(text); ++length) {
+		char terminated_text[64] = {0};
+		memcpy(terminated_text, text, length);
+		struct token_columns expected_tokens = {0};
+		struct lexer_error *expected_errors = NULL;
+		lex(terminated_text, &expected_tokens, &expected_errors);
+		struct token_columns tokens = {0};
+		struct lexer_error *errors = NULL;
+		lex_n(text, length, &tokens, &errors);
+		assert(tokens_are_equal(&tokens, &expected_tokens));
+		assert_eq(list_get_count(&errors), list_get_count(&expected_errors), "%zu", "%zu");
+		token_columns_destroy(&tokens);
+		list_destroy(&errors);
+		token_columns_destroy(&expected_tokens);
+		list_destroy(&expected_errors);
+	}
+}
+
+void test_lex_parallel_matches_lex_n(void) {
+	static const char *const lines[] = {
+		"pub namespace a.b.*\n", "\n", "  \n", "<x> a<b c < d\n", "// comment\n", "'x' \"y\" 'unclosed\n",
+		"\"unclosed\n", "var x = 12 >>= 3 ? \n", "\t\tfunc f(x)->y\n", "\n\n\n",
+	};
+	size_t text_capacity = 1024*1024;
+	char *text = malloc(text_capacity);
+	assert(text);
+	if (!text) {
+		return;
+	}
+	size_t text_length = 0;
+	srand(2);
+	while (true) {
+		const char *line = lines[rand()%(sizeof lines/sizeof *lines)];
+		if (text_length + strlen(line) > text_capacity) {
+			break;
+		}
+		memcpy(text + text_length, line, strlen(line));
+		text_length += strlen(line);
+	}
+
+	struct token_columns expected_tokens = {0};
+	struct lexer_error *expected_errors = NULL;
+	lex_n(text, text_length, &expected_tokens, &expected_errors);
+	for (size_t threads_count = 2; threads_count <= 9; ++threads_count) {
+		struct token_columns tokens = {0};
+		struct lexer_error *errors = NULL;
+		assert(lex_parallel(text, text_length, threads_count, &tokens, &errors));
+		assert(tokens_are_equal(&tokens, &expected_tokens));
+		assert_eq(list_get_count(&errors), list_get_count(&expected_errors), "%zu", "%zu");
+		for (size_t i = 0; i < list_get_count(&errors) && i < list_get_count(&expected_errors); ++i) {
+			assert_eq(errors[i].text_index, expected_errors[i].text_index, "%zu", "%zu");
+		}
+		assert_eq(list_get_count(&tokens.line_starts), list_get_count(&expected_tokens.line_starts), "%zu", "%zu");
+		if (list_get_count(&tokens.line_starts) == list_get_count(&expected_tokens.line_starts)) {
+			assert(!memcmp(tokens.line_starts, expected_tokens.line_starts, list_get_count(&tokens.line_starts)*sizeof *tokens.line_starts));
+		}
+		assert_eq(list_get_count(&tokens.constants.constants), list_get_count(&expected_tokens.constants.constants), "%zu", "%zu");
+		assert_eq(list_get_count(&tokens.constants.bytes), list_get_count(&expected_tokens.constants.bytes), "%zu", "%zu");
+		token_columns_destroy(&tokens);
+		list_destroy(&errors);
+	}
+	token_columns_destroy(&expected_tokens);
+	list_destroy(&expected_errors);
+	free(text);
+}
+
+void test_token_columns_long_lengths(void) {
+	struct token_columns tokens = token_columns_create(1);
+	assert(tokens.types);
+	if (!tokens.types) {
+		return;
+	}
+	struct token pushed_tokens[] = {
+		{.text_index = 0, .text_length = 3, .type = TOKEN_TYPE_IDENTIFIER},
+		{.text_index = 4, .text_length = 100000, .type = TOKEN_TYPE_STRING},
+		{.text_index = 100004, .text_length = TOKEN_LONG_LENGTH - 1, .type = TOKEN_TYPE_STRING},
+		{.text_index = 200000, .text_length = TOKEN_LONG_LENGTH, .type = TOKEN_TYPE_STRING},
+		{.text_index = 300000, .text_length = 1, .type = TOKEN_TYPE_NEWLINE},
+	};
+	size_t pushed_count = sizeof pushed_tokens/sizeof *pushed_tokens;
+	for (size_t i = 0; i < pushed_count; ++i) {
+		assert(token_columns_push_back(&tokens, pushed_tokens + i));
+	}
+	// Appending shifts the long lengths' token indices.
+	assert(token_columns_append(&tokens, &tokens));
+	assert_eq(token_columns_get_count(&tokens), 2*pushed_count, "%zu", "%zu");
+	for (size_t i = 0; i < 2*pushed_count; ++i) {
+		struct token token = token_columns_get(&tokens, i);
+		assert_eq(token.text_index, pushed_tokens[i%pushed_count].text_index, "%zu", "%zu");
+		assert_eq(token.text_length, pushed_tokens[i%pushed_count].text_length, "%zu", "%zu");
+		assert_eq(token.type, pushed_tokens[i%pushed_count].type, "%d", "%d");
+	}
+	struct token too_far = {.text_index = UINT32_MAX, .text_length = 1};
+	assert(!token_columns_push_back(&tokens, &too_far));
+	token_columns_destroy(&tokens);
+}
+
+void test_parse_stream_matches_parse(void) {
+	const char *text = "namespace a.b.*\n\n// comment\npub namespace c\n";
+	struct token_columns tokens = {0};
+	struct lexer_error *lexer_errors = NULL;
+	lex(text, &tokens, &lexer_errors);
+	struct segmented_list nodes = {0};
+	struct parser_error *parser_errors = NULL;
+	assert(parse(&tokens, &nodes, &parser_errors));
+
+	struct lexer lexer = lexer_create(text, strlen(text));
+	struct token_columns streamed_tokens = {0};
+	struct segmented_list streamed_nodes = {0};
+	struct parser_error *streamed_parser_errors = NULL;
+	assert(parse_stream(&lexer, &streamed_tokens, &streamed_nodes, &streamed_parser_errors));
+	assert(tokens_are_equal(&streamed_tokens, &tokens));
+	assert(nodes_are_equal(&streamed_nodes, &nodes));
+	assert_eq(list_get_count(&streamed_parser_errors), 0, "%zu", "%d");
+
+	token_columns_destroy(&tokens);
+	list_destroy(&lexer_errors);
+	segmented_list_destroy(&nodes);
+	list_destroy(&parser_errors);
+	token_columns_destroy(&streamed_tokens);
+	list_destroy(&lexer.errors);
+	segmented_list_destroy(&streamed_nodes);
+	list_destroy(&streamed_parser_errors);
+}
+
+void test_parse_stream_drops_skipped_tokens(void) {
+	const char *text = "namespace 1 2 3\nnamespace a\n";
+	struct lexer lexer = lexer_create(text, strlen(text));
+	struct token_columns tokens = {0};
+	struct segmented_list nodes = {0};
+	struct parser_error *errors = NULL;
+	parse_stream(&lexer, &tokens, &nodes, &errors);
+	assert_eq(list_get_count(&errors), 1, "%zu", "%d");
+	// Only `namespace`, the `1` the error is on, `namespace`, `a`, and the newline are kept.
+	assert_eq(token_columns_get_count(&tokens), 5, "%zu", "%d");
+	if (list_get_count(&errors) == 1) {
+		assert_eq(errors[0].tokens_index, 1, "%zu", "%d");
+		struct token token = token_columns_get(&tokens, errors[0].tokens_index);
+		assert(token.type == TOKEN_TYPE_NUMBER && token.text_index == 10);
+	}
+	token_columns_destroy(&tokens);
+	list_destroy(&lexer.errors);
+	segmented_list_destroy(&nodes);
+	list_destroy(&errors);
+}
+
+void test_parse_compact_matches_parse(void) {
+	const char *texts[] = {
+		"namespace a.b.*\n\n// comment\npub namespace c\n",
+		"namespace 1 2 3\nnamespace a\n",
+		"",
+	};
+	for (size_t i = 0; i < sizeof texts/sizeof *texts; ++i) {
+		struct token_columns tokens = {0};
+		struct lexer_error *lexer_errors = NULL;
+		lex(texts[i], &tokens, &lexer_errors);
+		struct segmented_list nodes = {0};
+		struct parser_error *parser_errors = NULL;
+		bool result = parse(&tokens, &nodes, &parser_errors);
+		struct syntax_tree tree = {0};
+		struct parser_error *compact_parser_errors = NULL;
+		assert_eq(parse_compact(&tokens, &tree, &compact_parser_errors), result, "%d", "%d");
+		// Token leaves aren't nodes anymore.
+		size_t inner_nodes_count = 0;
+		for (size_t j = 0; j < nodes.count; ++j) {
+			inner_nodes_count += ((struct node*)segmented_list_get(&nodes, j))->type != NODE_TYPE_TOKEN;
+		}
+		assert_eq(list_get_count(&tree.types), inner_nodes_count, "%zu", "%zu");
+		assert(tree.parents[0] == SYNTAX_TREE_NONE && tree_matches_nodes(&tree, 0, &nodes, 0));
+		assert_eq(list_get_count(&compact_parser_errors), list_get_count(&parser_errors), "%zu", "%zu");
+
+		token_columns_destroy(&tokens);
+		list_destroy(&lexer_errors);
+		segmented_list_destroy(&nodes);
+		list_destroy(&parser_errors);
+		syntax_tree_destroy(&tree);
+		list_destroy(&compact_parser_errors);
+	}
+}
+
+void test_initialize_symbols_ignores_spaces_in_names(void) {
+	const char *text = "namespace ab .c\n";
+	struct token_columns tokens = {0};
+	struct lexer_error *lexer_errors = NULL;
+	lex(text, &tokens, &lexer_errors);
+	struct segmented_list nodes = {0};
+	struct parser_error *parser_errors = NULL;
+	assert(parse(&tokens, &nodes, &parser_errors));
+	struct object object = object_create(NULL, 16, 1024);
+	struct compiler_error *compiler_errors = list_create(4, sizeof *compiler_errors);
+	assert(object.public_symbols.handles && compiler_errors);
+	assert(initialize_symbols(text, &tokens, &nodes, &object, &compiler_errors));
+
+	// The namespace is keyed by the atom of `ab.c`, the same as if it had been written without spaces.
+	uint32_t atom;
+	assert(interner_intern(interner_get_global(), "ab.c", 4, &atom));
+	assert(map_get_n(&object.public_symbols.namespaces, (const char*)&atom, sizeof atom));
+	assert(map_get_n(&object.public_symbols.handles, (const char*)&atom, sizeof atom));
+
+	token_columns_destroy(&tokens);
+	list_destroy(&lexer_errors);
+	segmented_list_destroy(&nodes);
+	list_destroy(&parser_errors);
+	object_destroy(&object);
+	list_destroy(&compiler_errors);
+}
+
+void test_initialize_symbols_without_definitions(void) {
+	// An empty file has no statements, and blank or comment lines are definitions with no children.
+	const char *texts[] = {"", "// comment\n\n", "\nnamespace a\n\n"};
+	for (size_t i = 0; i < sizeof texts/sizeof *texts; ++i) {
+		struct token_columns tokens = {0};
+		struct lexer_error *lexer_errors = NULL;
+		lex(texts[i], &tokens, &lexer_errors);
+		struct segmented_list nodes = {0};
+		struct parser_error *parser_errors = NULL;
+		assert(parse(&tokens, &nodes, &parser_errors));
+		struct compiler_error *compiler_errors = list_create(4, sizeof *compiler_errors);
+		assert(compiler_errors);
+		assert(initialize_symbols(texts[i], &tokens, &nodes, NULL, &compiler_errors));
+		assert_eq(list_get_count(&compiler_errors), 0, "%zu", "%d");
+		token_columns_destroy(&tokens);
+		list_destroy(&lexer_errors);
+		segmented_list_destroy(&nodes);
+		list_destroy(&parser_errors);
+		list_destroy(&compiler_errors);
+	}
+}
+
+void test_character_classes_match_ctype(void) {
+	for (int i = 0; i < 128; ++i) {
+		assert_eq(character_is(i, CHARACTER_CLASS_SPACE), isspace(i) != 0, "%d", "%d");
+		assert_eq(character_is(i, CHARACTER_CLASS_LINE_SPACE), isspace(i) && i != '\n', "%d", "%d");
+		assert_eq(character_is(i, CHARACTER_CLASS_DIGIT), isdigit(i) != 0, "%d", "%d");
+		assert_eq(character_is(i, CHARACTER_CLASS_LETTER), isalpha(i) != 0, "%d", "%d");
+		assert_eq(character_is(i, CHARACTER_CLASS_IDENTIFIER_START), isalpha(i) || i == '_', "%d", "%d");
+		assert_eq(character_is(i, CHARACTER_CLASS_IDENTIFIER), isalnum(i) || i == '_', "%d", "%d");
+	}
+	assert(character_is('\xC3', CHARACTER_CLASS_UTF8_LEAD));
+	assert(character_is('\xA9', CHARACTER_CLASS_UTF8_CONTINUATION));
+	assert(!character_is('\xC0', CHARACTER_CLASS_UTF8_LEAD | CHARACTER_CLASS_UTF8_CONTINUATION));
+	assert(!character_is('\xFF', CHARACTER_CLASS_UTF8_LEAD | CHARACTER_CLASS_UTF8_CONTINUATION));
+}
+
+void test_lex_decodes_literals(void) {
+	const char *text = "12 'a' '\\n' \"a\\tb\" 12 \"a\\tb\" '\xC3\xA9' \"\" 'ab' \"\\q\" 18446744073709551616 18446744073709551615";
+	struct token_columns tokens = {0};
+	struct lexer_error *errors = NULL;
+	lex(text, &tokens, &errors);
+	struct {
+		enum token_type type;
+		uint64_t value;
+		const char *string;
+	} expected[] = {
+		{TOKEN_TYPE_NUMBER, 12, NULL},
+		{TOKEN_TYPE_CHARACTER, 'a', NULL},
+		{TOKEN_TYPE_CHARACTER, '\n', NULL},
+		{TOKEN_TYPE_STRING, 0, "a\tb"},
+		{TOKEN_TYPE_NUMBER, 12, NULL},
+		{TOKEN_TYPE_STRING, 0, "a\tb"},
+		{TOKEN_TYPE_CHARACTER, 0xE9, NULL},
+		{TOKEN_TYPE_STRING, 0, ""},
+		{TOKEN_TYPE_STRING, 0, "q"},
+		{TOKEN_TYPE_NUMBER, UINT64_MAX, NULL},
+	};
+	assert_eq(token_columns_get_count(&tokens), sizeof expected/sizeof *expected, "%zu", "%zu");
+	for (size_t i = 0; i < token_columns_get_count(&tokens) && i < sizeof expected/sizeof *expected; ++i) {
+		struct token token = token_columns_get(&tokens, i);
+		assert_eq(token.type, expected[i].type, "%d", "%d");
+		struct constant *constant = tokens.constants.constants + token.constant_index;
+		assert_eq(constant->type, expected[i].type, "%d", "%d");
+		if (expected[i].string) {
+			assert_eq(constant->length, strlen(expected[i].string), "%u", "%zu");
+			assert(!memcmp(constant_pool_get_string(&tokens.constants, constant), expected[i].string, constant->length));
+		} else {
+			assert_eq(constant->value, expected[i].value, "%" PRIu64, "%" PRIu64);
+		}
+	}
+	// Equal literals share a constant.
+	assert_eq(token_columns_get(&tokens, 0).constant_index, token_columns_get(&tokens, 4).constant_index, "%u", "%u");
+	assert_eq(token_columns_get(&tokens, 3).constant_index, token_columns_get(&tokens, 5).constant_index, "%u", "%u");
+	assert_eq(list_get_count(&tokens.constants.constants), 8, "%zu", "%d");
+
+	enum lexer_error_type expected_errors[] = {
+		LEXER_ERROR_TYPE_INVALID_CHARACTER_LENGTH,
+		LEXER_ERROR_TYPE_UNKNOWN_ESCAPE_SEQUENCE,
+		LEXER_ERROR_TYPE_NUMBER_TOO_LARGE,
+	};
+	assert_eq(list_get_count(&errors), sizeof expected_errors/sizeof *expected_errors, "%zu", "%zu");
+	for (size_t i = 0; i < list_get_count(&errors) && i < sizeof expected_errors/sizeof *expected_errors; ++i) {
+		assert_eq(errors[i].type, expected_errors[i], "%d", "%d");
+	}
+	token_columns_destroy(&tokens);
+	list_destroy(&errors);
+}
+
+void test_lex_edit_matches_lex_n(void) {
+	static const char *const insertions[] = {
+		"", "\n", "\n\n", " ", "x", "var y = 1", "\"", "'", "\"a\\tb\"", "// c", "<", "@@", "12", "'\\n'",
+	};
+	const char *initial_text = "namespace a\n\nvar x = 12 >>= 3\n\"str\" 'c' <x> a<b\n// comment\n\tfunc f(x)->y\n\n";
+	size_t text_capacity = 4096;
+	char *text = malloc(text_capacity);
+	assert(text);
+	if (!text) {
+		return;
+	}
+	size_t text_length = strlen(initial_text);
+	memcpy(text, initial_text, text_length);
+	struct token_columns tokens = {0};
+	struct lexer_error *errors = NULL;
+	lex_n(text, text_length, &tokens, &errors);
+
+	srand(3);
+	for (size_t i = 0; i < 2000; ++i) {
+		// Make a random edit, keeping the text under its capacity.
+		const char *insertion = insertions[rand()%(sizeof insertions/sizeof *insertions)];
+		struct text_edit edit = {
+			.text_index = rand()%(text_length + 1),
+			.inserted_length = strlen(insertion),
+		};
+		edit.removed_length = rand()%(text_length - edit.text_index + 1)%8;
+		if (text_length - edit.removed_length + edit.inserted_length > text_capacity) {
+			edit.removed_length = text_length - edit.text_index;
+		}
+		memmove(text + edit.text_index + edit.inserted_length, text + edit.text_index + edit.removed_length, text_length - edit.text_index - edit.removed_length);
+		memcpy(text + edit.text_index, insertion, edit.inserted_length);
+		text_length = text_length - edit.removed_length + edit.inserted_length;
+		assert(lex_edit(text, text_length, &edit, &tokens, &errors));
+
+		struct token_columns expected_tokens = {0};
+		struct lexer_error *expected_errors = NULL;
+		lex_n(text, text_length, &expected_tokens, &expected_errors);
+		assert(tokens_are_equal(&tokens, &expected_tokens));
+		assert_eq(list_get_count(&tokens.line_starts), list_get_count(&expected_tokens.line_starts), "%zu", "%zu");
+		if (list_get_count(&tokens.line_starts) == list_get_count(&expected_tokens.line_starts)) {
+			assert(!memcmp(tokens.line_starts, expected_tokens.line_starts, list_get_count(&tokens.line_starts)*sizeof *tokens.line_starts));
+		}
+		assert_eq(list_get_count(&errors), list_get_count(&expected_errors), "%zu", "%zu");
+		for (size_t j = 0; j < list_get_count(&errors) && j < list_get_count(&expected_errors); ++j) {
+			assert_eq(errors[j].text_index, expected_errors[j].text_index, "%zu", "%zu");
+			assert_eq(errors[j].type, expected_errors[j].type, "%d", "%d");
+		}
+		token_columns_destroy(&expected_tokens);
+		list_destroy(&expected_errors);
+	}
+	token_columns_destroy(&tokens);
+	list_destroy(&errors);
+	free(text);
+}
+
+void test_token_columns_find_position(void) {
+	// Consecutive newlines become one token, but each still starts a line.
+	const char *text = "ab\n  c\n\n\nd";
+	struct token_columns tokens = {0};
+	struct lexer_error *errors = NULL;
+	assert(lex(text, &tokens, &errors));
+	struct {
+		size_t text_index;
+		struct text_position position;
+	} cases[] = {
+		{0, {1, 1}}, {1, {1, 2}}, {2, {1, 3}}, {5, {2, 3}}, {7, {3, 1}}, {8, {4, 1}}, {9, {5, 1}},
+	};
+	for (size_t i = 0; i < sizeof cases/sizeof *cases; ++i) {
+		struct text_position position = token_columns_find_position(&tokens, cases[i].text_index);
+		assert_eq(position.line, cases[i].position.line, "%zu", "%zu");
+		assert_eq(position.column, cases[i].position.column, "%zu", "%zu");
+	}
+	token_columns_destroy(&tokens);
+	list_destroy(&errors);
+}
+
 int main(void) {
 	begin_testing();
 		run_test(test_symbol_table_create_and_destroy);
 		run_test(test_object_create_and_destroy);
+		run_test(test_symbol_table_freeze);
+		run_test(test_arena_lists_and_maps);
+		run_test(test_hash_string);
+		run_test(test_interner);
+		run_test(test_map_add_get_remove);
+		run_test(test_concurrent_map);
+		run_test(test_list_reserve_append_and_shrink);
+		run_test(test_typed_list);
+		run_test(test_segmented_list_keeps_addresses);
+		run_test(test_lookup_keyword);
+		run_test(test_lex_keywords_and_identifiers);
+		run_test(test_lex_operators_longest_match);
+		run_test(test_lex_n_stops_at_length);
+		run_test(test_lex_decodes_literals);
+		run_test(test_lex_parallel_matches_lex_n);
+		run_test(test_lex_edit_matches_lex_n);
+		run_test(test_token_columns_long_lengths);
+		run_test(test_token_columns_find_position);
+		run_test(test_parse_stream_matches_parse);
+		run_test(test_parse_stream_drops_skipped_tokens);
+		run_test(test_parse_compact_matches_parse);
+		run_test(test_initialize_symbols_ignores_spaces_in_names);
+		run_test(test_initialize_symbols_without_definitions);
+		run_test(test_character_classes_match_ctype);
 	end_testing();
 	return 0;
 }